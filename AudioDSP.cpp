@@ -0,0 +1,666 @@
+#include "AudioDSP.h"
+#include <cmath>
+#include <algorithm>
+
+std::vector<float> audioDesignLowpass(size_t numTaps, double cutoff, double gain) {
+    std::vector<float> taps(numTaps);
+    const double center = (numTaps - 1) / 2.0;
+    double sum = 0;
+
+    for (size_t i = 0; i < numTaps; i++) {
+        const double t = i - center;
+        const double sinc = (t == 0) ? 2.0 * cutoff : std::sin(2.0 * M_PI * cutoff * t) / (M_PI * t);
+        //blackman window
+        const double w = (numTaps > 1) ? (0.42 - 0.5 * std::cos(2.0 * M_PI * i / (numTaps - 1))
+                + 0.08 * std::cos(4.0 * M_PI * i / (numTaps - 1))) : 1.0;
+        taps[i] = float(sinc * w);
+        sum += taps[i];
+    }
+
+    //normalize the DC gain
+    for (auto &tap : taps) tap = float(tap * gain / sum);
+
+    return taps;
+}
+
+/*******************************************************************
+ * NCO
+ ******************************************************************/
+
+AudioNCO::AudioNCO() {
+    frequency = 0;
+    sampleRate = 0;
+    phaseInc = 0;
+    stepRe = 1;
+    stepIm = 0;
+    reset();
+}
+
+void AudioNCO::setFrequency(double frequency, double sampleRate) {
+    this->frequency = frequency;
+    this->sampleRate = sampleRate;
+    phaseInc = (sampleRate > 0) ? (2.0 * M_PI * frequency / sampleRate) : 0;
+
+    //rotation applied to every lane per iteration
+    stepRe = float(std::cos(phaseInc * AUDIO_NCO_LANES));
+    stepIm = float(-std::sin(phaseInc * AUDIO_NCO_LANES));
+}
+
+double AudioNCO::getFrequency() const {
+    return frequency;
+}
+
+bool AudioNCO::isEnabled() const {
+    return phaseInc != 0;
+}
+
+void AudioNCO::reset() {
+    phase = 0;
+}
+
+void AudioNCO::mix(float *iq, size_t numSamples) {
+    //seed the lanes from the double precision phase accumulator,
+    //the float recurrence only has to hold for a single buffer
+    for (int k = 0; k < AUDIO_NCO_LANES; k++) {
+        laneRe[k] = float(std::cos(phase + k * phaseInc));
+        laneIm[k] = float(-std::sin(phase + k * phaseInc));
+    }
+
+    size_t i = 0;
+    int iterations = 0;
+
+    for (; i + AUDIO_NCO_LANES <= numSamples; i += AUDIO_NCO_LANES) {
+        float *s = iq + i * 2;
+        for (int k = 0; k < AUDIO_NCO_LANES; k++) {
+            const float re = s[k * 2];
+            const float im = s[k * 2 + 1];
+            s[k * 2] = re * laneRe[k] - im * laneIm[k];
+            s[k * 2 + 1] = re * laneIm[k] + im * laneRe[k];
+
+            const float nextRe = laneRe[k] * stepRe - laneIm[k] * stepIm;
+            laneIm[k] = laneRe[k] * stepIm + laneIm[k] * stepRe;
+            laneRe[k] = nextRe;
+        }
+
+        if (++iterations == AUDIO_NCO_NORM_INTERVAL) {
+            //first order correction is enough for the small drift per interval
+            for (int k = 0; k < AUDIO_NCO_LANES; k++) {
+                const float g = 1.5f - 0.5f * (laneRe[k] * laneRe[k] + laneIm[k] * laneIm[k]);
+                laneRe[k] *= g;
+                laneIm[k] *= g;
+            }
+            iterations = 0;
+        }
+    }
+
+    //remaining samples use the lanes as they stand
+    for (int k = 0; i < numSamples; i++, k++) {
+        float *s = iq + i * 2;
+        const float re = s[0];
+        const float im = s[1];
+        s[0] = re * laneRe[k] - im * laneIm[k];
+        s[1] = re * laneIm[k] + im * laneRe[k];
+    }
+
+    phase = std::fmod(phase + phaseInc * numSamples, 2.0 * M_PI);
+}
+
+/*******************************************************************
+ * Decimators
+ ******************************************************************/
+
+AudioFIRDecimator::AudioFIRDecimator() {
+    decimation = 1;
+    offset = 0;
+}
+
+void AudioFIRDecimator::configure(const std::vector<float> &taps, size_t decimation) {
+    this->taps = taps;
+    this->decimation = decimation;
+    reset();
+}
+
+void AudioFIRDecimator::reset() {
+    history.assign((taps.size() - 1) * 2, 0.0f);
+    offset = 0;
+}
+
+void AudioFIRDecimator::reserve(size_t numSamples) {
+    //less than a filter span is left over between calls
+    history.reserve((taps.size() - 1 + numSamples) * 2);
+}
+
+void AudioFIRDecimator::getBuffers(std::vector<std::vector<float> *> &buffers) {
+    buffers.push_back(&taps);
+    buffers.push_back(&history);
+}
+
+size_t AudioFIRDecimator::process(const float *in, size_t numSamples, float *out) {
+    //input is copied ahead of the output so in and out may alias
+    history.insert(history.end(), in, in + numSamples * 2);
+
+    const size_t numTaps = taps.size();
+    const size_t available = history.size() / 2;
+    const float *h = taps.data();
+    size_t count = 0;
+
+    while (offset + numTaps <= available) {
+        const float *x = history.data() + offset * 2;
+        float re = 0, im = 0;
+        for (size_t j = 0; j < numTaps; j++) {
+            re += h[j] * x[j * 2];
+            im += h[j] * x[j * 2 + 1];
+        }
+        out[count * 2] = re;
+        out[count * 2 + 1] = im;
+        count++;
+        offset += decimation;
+    }
+
+    const size_t consumed = std::min(offset, available);
+    history.erase(history.begin(), history.begin() + consumed * 2);
+    offset -= consumed;
+
+    return count;
+}
+
+AudioHalfbandDecimator::AudioHalfbandDecimator() {
+    //keep the center tap followed by the odd offset taps of one side
+    std::vector<float> full = audioDesignLowpass(AUDIO_HALFBAND_TAPS, 0.25);
+    const size_t center = AUDIO_HALFBAND_TAPS / 2;
+    taps.push_back(full[center]);
+    for (size_t j = 1; j <= center; j += 2) {
+        taps.push_back(full[center - j]);
+    }
+    reset();
+}
+
+void AudioHalfbandDecimator::reset() {
+    history.assign((AUDIO_HALFBAND_TAPS - 1) * 2, 0.0f);
+    offset = 0;
+}
+
+void AudioHalfbandDecimator::reserve(size_t numSamples) {
+    history.reserve((AUDIO_HALFBAND_TAPS - 1 + numSamples) * 2);
+}
+
+void AudioHalfbandDecimator::getBuffers(std::vector<std::vector<float> *> &buffers) {
+    buffers.push_back(&taps);
+    buffers.push_back(&history);
+}
+
+size_t AudioHalfbandDecimator::process(const float *in, size_t numSamples, float *out) {
+    history.insert(history.end(), in, in + numSamples * 2);
+
+    const size_t center = AUDIO_HALFBAND_TAPS / 2;
+    const size_t numFolded = taps.size() - 1;
+    const size_t available = history.size() / 2;
+    size_t count = 0;
+
+    while (offset + AUDIO_HALFBAND_TAPS <= available) {
+        const float *x = history.data() + (offset + center) * 2;
+        float re = taps[0] * x[0];
+        float im = taps[0] * x[1];
+        for (size_t k = 0; k < numFolded; k++) {
+            const size_t j = (2 * k + 1) * 2;
+            re += taps[k + 1] * (x[-(ptrdiff_t)j] + x[j]);
+            im += taps[k + 1] * (x[1 - (ptrdiff_t)j] + x[j + 1]);
+        }
+        out[count * 2] = re;
+        out[count * 2 + 1] = im;
+        count++;
+        offset += 2;
+    }
+
+    const size_t consumed = std::min(offset, available);
+    history.erase(history.begin(), history.begin() + consumed * 2);
+    offset -= consumed;
+
+    return count;
+}
+
+AudioDecimator::AudioDecimator() {
+    decimation = 1;
+    useFir = false;
+}
+
+bool AudioDecimator::isSupported(size_t decimation) {
+    return decimation >= 1 && decimation <= AUDIO_MAX_DECIMATION;
+}
+
+void AudioDecimator::configure(size_t decimation) {
+    this->decimation = decimation;
+
+    size_t remainder = decimation;
+    size_t numHalfbands = 0;
+    while (remainder > 1 && (remainder % 2) == 0) {
+        remainder /= 2;
+        numHalfbands++;
+    }
+
+    halfbands.assign(numHalfbands, AudioHalfbandDecimator());
+
+    useFir = (remainder > 1);
+    if (useFir) {
+        fir.configure(audioDesignLowpass(AUDIO_FIR_TAPS_PER_PHASE * remainder + 1, 0.45 / remainder), remainder);
+    }
+}
+
+double AudioDecimator::cost(size_t decimation, double outputRate) {
+    //folded halfband outputs at each intermediate rate
+    double total = 0;
+    double rate = outputRate * decimation;
+    size_t remainder = decimation;
+    while (remainder > 1 && (remainder % 2) == 0) {
+        rate /= 2;
+        remainder /= 2;
+        total += rate * (AUDIO_HALFBAND_TAPS / 4 + 2);
+    }
+    if (remainder > 1) {
+        total += outputRate * (AUDIO_FIR_TAPS_PER_PHASE * remainder + 1);
+    }
+    return total;
+}
+
+size_t AudioDecimator::getDecimation() const {
+    return decimation;
+}
+
+void AudioDecimator::reset() {
+    for (auto &hb : halfbands) hb.reset();
+    if (useFir) fir.reset();
+}
+
+void AudioDecimator::reserve(size_t numSamples) {
+    //each halfband hands at most half its input plus one to the next stage
+    for (auto &hb : halfbands) {
+        hb.reserve(numSamples);
+        numSamples = numSamples / 2 + 1;
+    }
+    if (useFir) fir.reserve(numSamples);
+}
+
+void AudioDecimator::getBuffers(std::vector<std::vector<float> *> &buffers) {
+    for (auto &hb : halfbands) hb.getBuffers(buffers);
+    if (useFir) fir.getBuffers(buffers);
+}
+
+size_t AudioDecimator::process(const float *in, size_t numSamples, float *out) {
+    //each stage writes fewer samples than it reads,
+    //so everything after the first stage runs in-place on out
+    const float *src = in;
+    size_t count = numSamples;
+    for (auto &hb : halfbands) {
+        count = hb.process(src, count, out);
+        src = out;
+    }
+    if (useFir) {
+        count = fir.process(src, count, out);
+    }
+    return count;
+}
+
+/*******************************************************************
+ * Resampler
+ ******************************************************************/
+
+AudioResampler::AudioResampler() {
+    ratio = 1;
+    step = 1;
+    position = 0;
+}
+
+void AudioResampler::configure(double ratio) {
+    //prototype at the upsampled rate, cutoff below the narrower nyquist
+    const size_t numTaps = AUDIO_RESAMP_PHASES * AUDIO_RESAMP_TAPS_PER_PHASE + 1;
+    const double cutoff = 0.4 * std::min(1.0, ratio) / AUDIO_RESAMP_PHASES;
+    std::vector<float> proto = audioDesignLowpass(numTaps, cutoff, AUDIO_RESAMP_PHASES);
+
+    //one extra phase so phase p+1 always exists for interpolation,
+    //taps are stored oldest sample first to match the history layout
+    const size_t rowLen = AUDIO_RESAMP_TAPS_PER_PHASE + 1;
+    bank.assign((AUDIO_RESAMP_PHASES + 1) * rowLen, 0.0f);
+    for (size_t p = 0; p <= AUDIO_RESAMP_PHASES; p++) {
+        for (size_t j = 0; j < rowLen; j++) {
+            const size_t idx = j * AUDIO_RESAMP_PHASES + p;
+            if (idx < numTaps) bank[p * rowLen + (rowLen - 1 - j)] = proto[idx];
+        }
+    }
+
+    setRatio(ratio);
+    reset();
+}
+
+void AudioResampler::setRatio(double ratio) {
+    this->ratio = ratio;
+    step = 1.0 / ratio;
+}
+
+double AudioResampler::getRatio() const {
+    return ratio;
+}
+
+void AudioResampler::reset() {
+    const size_t rowLen = AUDIO_RESAMP_TAPS_PER_PHASE + 1;
+    history.assign((rowLen - 1) * 2, 0.0f);
+    position = rowLen - 1;
+}
+
+void AudioResampler::reserve(size_t numSamples) {
+    const size_t rowLen = AUDIO_RESAMP_TAPS_PER_PHASE + 1;
+    history.reserve((rowLen - 1 + numSamples) * 2);
+}
+
+void AudioResampler::getBuffers(std::vector<std::vector<float> *> &buffers) {
+    buffers.push_back(&bank);
+    buffers.push_back(&history);
+}
+
+size_t AudioResampler::maxOutput(size_t numSamples) const {
+    return size_t(numSamples * ratio) + 2;
+}
+
+size_t AudioResampler::process(const float *in, size_t numSamples, float *out) {
+    history.insert(history.end(), in, in + numSamples * 2);
+
+    const size_t rowLen = AUDIO_RESAMP_TAPS_PER_PHASE + 1;
+    const size_t available = history.size() / 2;
+    size_t count = 0;
+
+    while (size_t(position) < available) {
+        const size_t n = size_t(position);
+        const double phase = (position - n) * AUDIO_RESAMP_PHASES;
+        const size_t p = size_t(phase);
+        const float a = float(phase - p);
+
+        const float *x = history.data() + (n + 1 - rowLen) * 2;
+        const float *h0 = bank.data() + p * rowLen;
+        const float *h1 = h0 + rowLen;
+
+        float re0 = 0, im0 = 0, re1 = 0, im1 = 0;
+        for (size_t j = 0; j < rowLen; j++) {
+            re0 += h0[j] * x[j * 2];
+            im0 += h0[j] * x[j * 2 + 1];
+            re1 += h1[j] * x[j * 2];
+            im1 += h1[j] * x[j * 2 + 1];
+        }
+
+        out[count * 2] = re0 + a * (re1 - re0);
+        out[count * 2 + 1] = im0 + a * (im1 - im0);
+        count++;
+        position += step;
+    }
+
+    //keep the samples still covered by the filter span
+    const size_t consumed = std::min(size_t(position) + 1 - rowLen, available);
+    history.erase(history.begin(), history.begin() + consumed * 2);
+    position -= consumed;
+
+    return count;
+}
+
+double AudioResampler::cost(double outputRate) {
+    return outputRate * 2 * (AUDIO_RESAMP_TAPS_PER_PHASE + 1);
+}
+
+/*******************************************************************
+ * Rx chain
+ ******************************************************************/
+
+void AudioRxChain::configure(size_t decimation, double resampleRatio) {
+    nco.reset();
+    decimator.configure(decimation);
+    resampler.configure(resampleRatio);
+}
+
+void AudioRxChain::reserve(size_t numSamples) {
+    decimator.reserve(numSamples);
+    resampler.reserve(numSamples / decimator.getDecimation() + 1);
+}
+
+void AudioRxChain::getBuffers(std::vector<std::vector<float> *> &buffers) {
+    decimator.getBuffers(buffers);
+    resampler.getBuffers(buffers);
+}
+
+size_t AudioRxChain::maxOutput(size_t numSamples, bool resampling) const {
+    const size_t decimated = numSamples / decimator.getDecimation() + 1;
+    return resampling ? resampler.maxOutput(decimated) : decimated;
+}
+
+size_t AudioRxChain::process(float *iq, size_t numSamples, bool resampling, float *out) {
+    if (nco.isEnabled()) {
+        nco.mix(iq, numSamples);
+    }
+
+    size_t count = numSamples;
+    if (decimator.getDecimation() > 1) {
+        count = decimator.process(iq, count, resampling ? iq : out);
+        if (!resampling) return count;
+    }
+    if (resampling) {
+        return resampler.process(iq, count, out);
+    }
+
+    std::copy(iq, iq + count * 2, out);
+    return count;
+}
+
+/*******************************************************************
+ * Rate estimator
+ ******************************************************************/
+
+AudioRateEstimator::AudioRateEstimator() {
+    reset(0);
+}
+
+void AudioRateEstimator::reset(double nominalRate) {
+    this->nominalRate = nominalRate;
+    framePeriod = (nominalRate > 0) ? 1.0 / nominalRate : 0;
+    predicted = 0;
+    elapsed = 0;
+    started = false;
+}
+
+void AudioRateEstimator::update(double now, size_t numFrames) {
+    if (framePeriod == 0 || numFrames == 0) return;
+
+    if (!started) {
+        predicted = now;
+        started = true;
+        return;
+    }
+
+    const double period = numFrames * framePeriod;
+    predicted += period;
+    const double err = now - predicted;
+
+    //scheduling stalls are not clock drift, start over from here
+    if (std::abs(err) > 4 * period) {
+        predicted = now;
+        return;
+    }
+
+    const double bw = (elapsed < AUDIO_DLL_COARSE_SECONDS) ? AUDIO_DLL_BANDWIDTH_COARSE : AUDIO_DLL_BANDWIDTH_FINE;
+    const double omega = 2.0 * M_PI * bw * period;
+
+    predicted += std::sqrt(2.0) * omega * err;
+    framePeriod += omega * omega * err / numFrames;
+    elapsed += period;
+
+    //keep the estimate within a sane crystal tolerance
+    const double nominalPeriod = 1.0 / nominalRate;
+    framePeriod = std::min(std::max(framePeriod, nominalPeriod * 0.99), nominalPeriod * 1.01);
+}
+
+void AudioRateEstimator::resync() {
+    started = false;
+}
+
+double AudioRateEstimator::getRate() const {
+    return (framePeriod > 0) ? 1.0 / framePeriod : 0;
+}
+
+bool AudioRateEstimator::isSettled() const {
+    return elapsed >= AUDIO_DLL_COARSE_SECONDS;
+}
+
+/*******************************************************************
+ * FFT
+ ******************************************************************/
+
+AudioFFT::AudioFFT() {
+    size = 0;
+}
+
+void AudioFFT::configure(size_t size) {
+    this->size = size;
+
+    size_t bits = 0;
+    while ((size_t(1) << bits) < size) bits++;
+
+    reversed.resize(size);
+    for (size_t i = 0; i < size; i++) {
+        size_t r = 0;
+        for (size_t b = 0; b < bits; b++) {
+            if (i & (size_t(1) << b)) r |= size_t(1) << (bits - 1 - b);
+        }
+        reversed[i] = r;
+    }
+
+    //forward twiddles for the largest stage, smaller stages stride through them
+    twiddles.resize(size);
+    for (size_t i = 0; i < size / 2; i++) {
+        twiddles[i * 2] = float(std::cos(2.0 * M_PI * i / size));
+        twiddles[i * 2 + 1] = float(-std::sin(2.0 * M_PI * i / size));
+    }
+}
+
+size_t AudioFFT::getSize() const {
+    return size;
+}
+
+void AudioFFT::getBuffers(std::vector<std::vector<float> *> &buffers) {
+    buffers.push_back(&twiddles);
+}
+
+void AudioFFT::transform(float *iq, bool inverse) const {
+    for (size_t i = 0; i < size; i++) {
+        const size_t r = reversed[i];
+        if (r > i) {
+            std::swap(iq[i * 2], iq[r * 2]);
+            std::swap(iq[i * 2 + 1], iq[r * 2 + 1]);
+        }
+    }
+
+    const float sign = inverse ? -1.0f : 1.0f;
+
+    for (size_t len = 2; len <= size; len *= 2) {
+        const size_t half = len / 2;
+        const size_t stride = size / len;
+        for (size_t base = 0; base < size; base += len) {
+            for (size_t j = 0; j < half; j++) {
+                const float wr = twiddles[j * stride * 2];
+                const float wi = sign * twiddles[j * stride * 2 + 1];
+                float *a = iq + (base + j) * 2;
+                float *b = iq + (base + j + half) * 2;
+                const float tr = b[0] * wr - b[1] * wi;
+                const float ti = b[0] * wi + b[1] * wr;
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+}
+
+/*******************************************************************
+ * Channelizer
+ ******************************************************************/
+
+AudioChannelizer::AudioChannelizer() {
+    numChannels = 0;
+    offset = 0;
+}
+
+bool AudioChannelizer::isSupported(size_t numChannels) {
+    return numChannels >= 2 && numChannels <= AUDIO_MAX_CHANNELIZER && (numChannels & (numChannels - 1)) == 0;
+}
+
+void AudioChannelizer::configure(size_t numChannels) {
+    this->numChannels = numChannels;
+
+    //taps are reversed so they line up with the oldest-first history
+    const size_t numTaps = numChannels * AUDIO_CHANNELIZER_TAPS_PER_BRANCH;
+    taps = audioDesignLowpass(numTaps, 0.5 / numChannels);
+    std::reverse(taps.begin(), taps.end());
+
+    fold.resize(numChannels * 2);
+    fft.configure(numChannels);
+    reset();
+}
+
+size_t AudioChannelizer::getNumChannels() const {
+    return numChannels;
+}
+
+void AudioChannelizer::reset() {
+    history.assign((taps.size() - 1) * 2, 0.0f);
+    offset = 0;
+}
+
+void AudioChannelizer::reserve(size_t numSamples) {
+    history.reserve((taps.size() - 1 + numSamples) * 2);
+}
+
+void AudioChannelizer::getBuffers(std::vector<std::vector<float> *> &buffers) {
+    buffers.push_back(&taps);
+    buffers.push_back(&history);
+    buffers.push_back(&fold);
+    fft.getBuffers(buffers);
+}
+
+size_t AudioChannelizer::maxOutput(size_t numSamples) const {
+    return numSamples / numChannels + 1;
+}
+
+size_t AudioChannelizer::process(const float *in, size_t numSamples, float *out, size_t planeStride) {
+    history.insert(history.end(), in, in + numSamples * 2);
+
+    const size_t numTaps = taps.size();
+    const size_t available = history.size() / 2;
+    size_t count = 0;
+
+    while (offset + numTaps <= available) {
+        const float *x = history.data() + offset * 2;
+
+        //fold the windowed span onto the branches, the newest sample
+        //lands on branch 0 so channel k needs no per-output rotation
+        for (size_t m = 0; m < numChannels; m++) {
+            float re = 0, im = 0;
+            for (size_t j = numTaps - 1 - m; j < numTaps; j -= numChannels) {
+                re += taps[j] * x[j * 2];
+                im += taps[j] * x[j * 2 + 1];
+                if (j < numChannels) break;
+            }
+            fold[m * 2] = re;
+            fold[m * 2 + 1] = im;
+        }
+
+        fft.transform(fold.data(), true);
+
+        for (size_t k = 0; k < numChannels; k++) {
+            out[(k * planeStride + count) * 2] = fold[k * 2];
+            out[(k * planeStride + count) * 2 + 1] = fold[k * 2 + 1];
+        }
+        count++;
+        offset += numChannels;
+    }
+
+    const size_t consumed = std::min(offset, available);
+    history.erase(history.begin(), history.begin() + consumed * 2);
+    offset -= consumed;
+
+    return count;
+}
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+//number of interleaved phasors used by the NCO recurrence,
+//independent lanes keep the inner loop free of serial dependencies
+#define AUDIO_NCO_LANES 4
+
+//lane iterations between re-normalization of the phasors
+#define AUDIO_NCO_NORM_INTERVAL 256
+
+//taps of the halfband stages, must be of the form 4k+3
+#define AUDIO_HALFBAND_TAPS 47
+
+//taps per output sample of the final decimating FIR stage
+#define AUDIO_FIR_TAPS_PER_PHASE 16
+
+//largest decimation offered below a native device rate
+#define AUDIO_MAX_DECIMATION 64
+
+//rate estimator loop bandwidths, wide until settled then narrow for ppm accuracy
+#define AUDIO_DLL_BANDWIDTH_COARSE 1.0
+#define AUDIO_DLL_BANDWIDTH_FINE 0.02
+#define AUDIO_DLL_COARSE_SECONDS 5.0
+
+//channelizer prototype taps per polyphase branch and channel count limit
+#define AUDIO_CHANNELIZER_TAPS_PER_BRANCH 12
+#define AUDIO_MAX_CHANNELIZER 256
+
+//polyphase resampler geometry, outputs interpolate between adjacent phases
+#define AUDIO_RESAMP_PHASES 64
+#define AUDIO_RESAMP_TAPS_PER_PHASE 32
+
+//windowed-sinc lowpass, cutoff relative to the sample rate
+std::vector<float> audioDesignLowpass(size_t numTaps, double cutoff, double gain = 1.0);
+
+class AudioNCO {
+public:
+    AudioNCO();
+
+    void setFrequency(double frequency, double sampleRate);
+    double getFrequency() const;
+    bool isEnabled() const;
+    void reset();
+
+    //shift interleaved complex float samples by -frequency in-place
+    void mix(float *iq, size_t numSamples);
+
+private:
+    double frequency, sampleRate;
+    double phase, phaseInc;
+    float stepRe, stepIm;
+    float laneRe[AUDIO_NCO_LANES], laneIm[AUDIO_NCO_LANES];
+};
+
+//decimating FIR over interleaved complex float samples,
+//only the retained outputs are computed
+class AudioFIRDecimator {
+public:
+    AudioFIRDecimator();
+
+    void configure(const std::vector<float> &taps, size_t decimation);
+    void reset();
+
+    //room for numSamples per call, so process does not allocate
+    void reserve(size_t numSamples);
+    void getBuffers(std::vector<std::vector<float> *> &buffers);
+
+    //returns the number of samples written to out
+    size_t process(const float *in, size_t numSamples, float *out);
+
+private:
+    std::vector<float> taps;
+    std::vector<float> history;
+    size_t decimation, offset;
+};
+
+//halfband decimate-by-2, skips the zero taps and folds the symmetric ones
+class AudioHalfbandDecimator {
+public:
+    AudioHalfbandDecimator();
+
+    void reset();
+    void reserve(size_t numSamples);
+    void getBuffers(std::vector<std::vector<float> *> &buffers);
+    size_t process(const float *in, size_t numSamples, float *out);
+
+private:
+    std::vector<float> taps;
+    std::vector<float> history;
+    size_t offset;
+};
+
+//halfband cascade for the power of two part of the decimation
+//followed by a FIR stage for the remaining factor
+class AudioDecimator {
+public:
+    AudioDecimator();
+
+    static bool isSupported(size_t decimation);
+
+    //multiply-accumulates per second to produce outputRate
+    static double cost(size_t decimation, double outputRate);
+
+    void configure(size_t decimation);
+    size_t getDecimation() const;
+    void reset();
+    void reserve(size_t numSamples);
+    void getBuffers(std::vector<std::vector<float> *> &buffers);
+
+    //in and out may alias, returns the number of output samples
+    size_t process(const float *in, size_t numSamples, float *out);
+
+private:
+    size_t decimation;
+    std::vector<AudioHalfbandDecimator> halfbands;
+    AudioFIRDecimator fir;
+    bool useFir;
+};
+
+//arbitrary ratio polyphase resampler over interleaved complex float samples
+class AudioResampler {
+public:
+    AudioResampler();
+
+    //ratio is output rate over input rate, the filter is designed for it
+    void configure(double ratio);
+
+    //small ratio adjustments without redesigning the filter
+    void setRatio(double ratio);
+    double getRatio() const;
+
+    void reset();
+    void reserve(size_t numSamples);
+    void getBuffers(std::vector<std::vector<float> *> &buffers);
+
+    //upper bound of outputs for numSamples inputs
+    size_t maxOutput(size_t numSamples) const;
+
+    //in and out must not alias, returns the number of output samples
+    size_t process(const float *in, size_t numSamples, float *out);
+
+    //multiply-accumulates per second to produce outputRate
+    static double cost(double outputRate);
+
+private:
+    double ratio, step, position;
+    std::vector<float> bank;
+    std::vector<float> history;
+};
+
+//per channel chain from the device rate to the output rate
+class AudioRxChain {
+public:
+    AudioNCO nco;
+    AudioDecimator decimator;
+    AudioResampler resampler;
+
+    void configure(size_t decimation, double resampleRatio);
+
+    //room for periods of up to numSamples at the device rate
+    void reserve(size_t numSamples);
+
+    //every vector process touches, for locking into memory
+    void getBuffers(std::vector<std::vector<float> *> &buffers);
+
+    //upper bound of outputs for numSamples inputs
+    size_t maxOutput(size_t numSamples, bool resampling) const;
+
+    //iq is scratch at the device rate and gets overwritten,
+    //returns the number of samples written to out
+    size_t process(float *iq, size_t numSamples, bool resampling, float *out);
+};
+
+//delay-locked loop over callback arrival times, estimates the real
+//device rate against the host clock from the frames delivered per callback
+class AudioRateEstimator {
+public:
+    AudioRateEstimator();
+
+    void reset(double nominalRate);
+
+    //now is the host time in seconds at which numFrames were delivered
+    void update(double now, size_t numFrames);
+
+    //drop the time reference after lost samples, keeps the rate estimate
+    void resync();
+
+    double getRate() const;
+    bool isSettled() const;
+
+private:
+    double nominalRate, framePeriod, predicted, elapsed;
+    bool started;
+};
+
+//in-place radix-2 complex FFT over interleaved floats
+class AudioFFT {
+public:
+    AudioFFT();
+
+    void configure(size_t size);
+    size_t getSize() const;
+    void getBuffers(std::vector<std::vector<float> *> &buffers);
+
+    //unscaled, inverse uses the positive exponent
+    void transform(float *iq, bool inverse) const;
+
+private:
+    size_t size;
+    std::vector<size_t> reversed;
+    std::vector<float> twiddles;
+};
+
+//critically sampled polyphase filterbank analysis, splits the input into
+//uniformly spaced channels at 1/numChannels of the input rate
+class AudioChannelizer {
+public:
+    AudioChannelizer();
+
+    static bool isSupported(size_t numChannels);
+
+    void configure(size_t numChannels);
+    size_t getNumChannels() const;
+    void reset();
+    void reserve(size_t numSamples);
+    void getBuffers(std::vector<std::vector<float> *> &buffers);
+
+    //upper bound of outputs per channel for numSamples inputs
+    size_t maxOutput(size_t numSamples) const;
+
+    //channel k is written to out + k * planeStride * 2,
+    //returns the number of output samples per channel
+    size_t process(const float *in, size_t numSamples, float *out, size_t planeStride);
+
+private:
+    size_t numChannels, offset;
+    std::vector<float> taps;
+    std::vector<float> history;
+    std::vector<float> fold;
+    AudioFFT fft;
+};
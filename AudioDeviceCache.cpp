@@ -0,0 +1,334 @@
+#include "AudioDeviceCache.h"
+#include <SoapySDR/Logger.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//results shared by every device and find call in the process
+struct AudioProbeResults {
+    std::string fingerprint;
+    unsigned int count;
+    std::vector<RtAudio::DeviceInfo> devices;
+    std::chrono::steady_clock::time_point probedAt;
+};
+
+static std::mutex probeMutex;
+static std::map<RtAudio::Api, AudioProbeResults> probeResults;
+static std::map<RtAudio::Api, std::unique_ptr<RtAudio>> probeHandles;
+
+//probes shared between the caller and the workers, the workers hold a reference
+//so one that is stuck in a driver call can outlive the caller
+struct AudioProbeJob {
+    RtAudio::Api api;
+    std::vector<unsigned int> indices;
+    std::vector<RtAudio::DeviceInfo> results;
+    std::vector<char> done;
+    std::vector<std::chrono::steady_clock::time_point> started;
+    size_t next;
+    std::mutex mutex;
+    std::condition_variable cond;
+};
+
+static std::string cachePath(RtAudio::Api api) {
+#ifdef _WIN32
+    return "";
+#else
+    std::string base;
+    const char *xdg = std::getenv("XDG_CACHE_HOME");
+    const char *home = std::getenv("HOME");
+    if (xdg != nullptr && xdg[0] != '\0') base = xdg;
+    else if (home != nullptr && home[0] != '\0') base = std::string(home) + "/.cache";
+    else return "";
+    return base + "/SoapyAudio/devices-" + RtAudio::getApiName(api) + ".cache";
+#endif
+}
+
+//stable across processes and builds, unlike std::hash
+static uint64_t fnv1a(const std::string &data) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+//backends behind a sound server, whose port and node lists change without any hardware change
+static bool isSoundServer(RtAudio::Api api) {
+#ifdef RTAUDIO_SOAPY_EXTENSIONS
+    if (api == RtAudio::LINUX_PIPEWIRE) return true;
+#endif
+    return api == RtAudio::UNIX_JACK || api == RtAudio::LINUX_PULSE;
+}
+
+std::string audioDeviceFingerprint(RtAudio::Api api) {
+#ifdef __linux__
+    if (isSoundServer(api)) return "";
+
+    //one line pair per card with its index, id, driver and for USB the bus path
+    std::ifstream cards("/proc/asound/cards");
+    if (!cards) return "";
+    std::stringstream contents;
+    contents << cards.rdbuf();
+
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long) fnv1a(contents.str()));
+    return hex;
+#else
+    return "";
+#endif
+}
+
+static bool loadCache(RtAudio::Api api, const std::string &fingerprint, unsigned int count, std::vector<RtAudio::DeviceInfo> &devices) {
+    const std::string path = cachePath(api);
+    if (path.empty()) return false;
+    std::ifstream file(path);
+    if (!file) return false;
+
+    std::string line, magic, cacheFingerprint;
+    int version = 0;
+    unsigned int cacheCount = 0;
+
+    if (!std::getline(file, line)) return false;
+    std::istringstream header(line);
+    header >> magic >> version;
+    if (magic != "SoapyAudio" || version != AUDIO_DEVICE_CACHE_VERSION) return false;
+
+    if (!std::getline(file, line)) return false;
+    std::istringstream validation(line);
+    validation >> cacheFingerprint >> cacheCount;
+    if (cacheFingerprint != fingerprint || cacheCount != count) return false;
+
+    std::vector<RtAudio::DeviceInfo> cached;
+    while (cached.size() < count && std::getline(file, line)) {
+        std::istringstream fields(line);
+        RtAudio::DeviceInfo info;
+        size_t numRates = 0;
+        fields >> info.probed >> info.outputChannels >> info.inputChannels >> info.duplexChannels
+               >> info.isDefaultOutput >> info.isDefaultInput >> info.preferredSampleRate
+               >> info.nativeFormats >> numRates;
+        info.sampleRates.resize(numRates);
+        for (auto &rate : info.sampleRates) fields >> rate;
+        if (!fields) return false;
+
+        //the name is the rest of the line and may hold spaces
+        fields.get();
+        std::getline(fields, info.name);
+        cached.push_back(info);
+    }
+    if (cached.size() != count) return false;
+
+    devices.swap(cached);
+    return true;
+}
+
+static void storeCache(RtAudio::Api api, const std::string &fingerprint, const std::vector<RtAudio::DeviceInfo> &devices) {
+#ifndef _WIN32
+    const std::string path = cachePath(api);
+    if (path.empty()) return;
+
+    //create the parents, failures show up when the file is opened
+    for (size_t pos = path.find('/', 1); pos != std::string::npos; pos = path.find('/', pos + 1)) {
+        mkdir(path.substr(0, pos).c_str(), 0755);
+    }
+
+    //written aside and renamed so concurrent readers never see a partial file
+    const std::string temp = path + ".tmp." + std::to_string(getpid());
+    {
+        std::ofstream file(temp, std::ios::trunc);
+        if (!file) return;
+        file << "SoapyAudio " << AUDIO_DEVICE_CACHE_VERSION << "\n";
+        file << fingerprint << " " << devices.size() << "\n";
+        for (const auto &info : devices) {
+            file << info.probed << " " << info.outputChannels << " " << info.inputChannels << " "
+                 << info.duplexChannels << " " << info.isDefaultOutput << " " << info.isDefaultInput << " "
+                 << info.preferredSampleRate << " " << info.nativeFormats << " " << info.sampleRates.size();
+            for (auto rate : info.sampleRates) file << " " << rate;
+            file << " " << info.name << "\n";
+        }
+        if (!file) {
+            std::remove(temp.c_str());
+            return;
+        }
+    }
+    if (std::rename(temp.c_str(), path.c_str()) != 0) std::remove(temp.c_str());
+#endif
+}
+
+static void probeWorker(std::shared_ptr<AudioProbeJob> job) {
+    //backends keep per-handle state, so every worker opens its own
+    std::unique_ptr<RtAudio> dac;
+    try {
+        dac.reset(new RtAudio(job->api));
+    } catch (RtAudioError &) {
+    }
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    while (job->next < job->indices.size()) {
+        const size_t k = job->next++;
+        job->started[k] = std::chrono::steady_clock::now();
+        lock.unlock();
+
+        RtAudio::DeviceInfo info;
+        try {
+            if (dac) info = dac->getDeviceInfo(job->indices[k]);
+        } catch (RtAudioError &) {
+        }
+
+        lock.lock();
+        job->results[k] = info;
+        job->done[k] = 1;
+        job->cond.notify_all();
+    }
+}
+
+//probe the given devices on a small pool, results keep the device order,
+//a device whose probe does not return in time stays unprobed
+static void probeParallel(RtAudio::Api api, const std::vector<unsigned int> &indices, std::vector<RtAudio::DeviceInfo> &devices) {
+    std::shared_ptr<AudioProbeJob> job(new AudioProbeJob());
+    job->api = api;
+    job->indices = indices;
+    job->results.resize(indices.size());
+    job->done.assign(indices.size(), 0);
+    job->started.resize(indices.size());
+    job->next = 0;
+
+    const std::chrono::milliseconds timeout(AUDIO_PROBE_TIMEOUT_MS);
+    std::vector<char> expired(indices.size(), 0);
+    size_t numWorkers = std::min<size_t>(AUDIO_PROBE_THREADS, indices.size());
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    for (size_t i = 0; i < numWorkers; i++) std::thread(probeWorker, job).detach();
+
+    while (true) {
+        const auto now = std::chrono::steady_clock::now();
+        auto wake = now + timeout;
+        bool finished = true;
+
+        for (size_t k = 0; k < indices.size(); k++) {
+            if (job->done[k] || expired[k]) continue;
+            if (k >= job->next) {
+                finished = false;
+                continue;
+            }
+            if (now - job->started[k] >= timeout) {
+                //the stuck worker is abandoned, a new one takes its place
+                expired[k] = 1;
+                SoapySDR_logf(SOAPY_SDR_WARNING, "Probing audio device %u timed out", indices[k]);
+                if (job->next < indices.size()) std::thread(probeWorker, job).detach();
+                continue;
+            }
+            finished = false;
+            wake = std::min(wake, job->started[k] + timeout);
+        }
+
+        if (finished) break;
+        job->cond.wait_until(lock, wake);
+    }
+
+    for (size_t k = 0; k < indices.size(); k++) {
+        if (job->done[k]) devices[indices[k]] = job->results[k];
+    }
+}
+
+//sound servers describe every device in the one enumeration getDeviceCount does,
+//so nothing is probed per device, ports and nodes come and go so nothing is stored
+static const std::vector<RtAudio::DeviceInfo> &probeServer(RtAudio &dac, AudioProbeResults &results) {
+    const auto now = std::chrono::steady_clock::now();
+    if (!results.devices.empty() && now - results.probedAt < std::chrono::milliseconds(AUDIO_SERVER_REFRESH_MS)) {
+        return results.devices;
+    }
+
+    std::vector<RtAudio::DeviceInfo> devices(dac.getDeviceCount());
+    for (unsigned int i = 0; i < devices.size(); i++) {
+        try {
+            devices[i] = dac.getDeviceInfo(i);
+        } catch (RtAudioError &) {
+        }
+    }
+
+    results.fingerprint.clear();
+    results.count = devices.size();
+    results.devices.swap(devices);
+    results.probedAt = now;
+    return results.devices;
+}
+
+//called with probeMutex held
+static const std::vector<RtAudio::DeviceInfo> &probeDevices(RtAudio &dac) {
+    const RtAudio::Api api = dac.getCurrentApi();
+    AudioProbeResults &results = probeResults[api];
+    if (isSoundServer(api)) return probeServer(dac, results);
+
+    const unsigned int count = dac.getDeviceCount();
+    const std::string fingerprint = audioDeviceFingerprint(api);
+
+    //a hot-plug changes the card list or the device count, anything else is reused
+    const bool current = results.fingerprint == fingerprint &&
+            results.count == count && results.devices.size() == count;
+
+    std::vector<RtAudio::DeviceInfo> devices;
+    bool changed = true;
+    if (current) {
+        bool complete = true;
+        for (const auto &info : results.devices) complete = complete && info.probed;
+        if (complete) return results.devices;
+        devices = results.devices;
+        changed = false;
+    } else if (!fingerprint.empty() && loadCache(api, fingerprint, count, devices)) {
+        changed = false;
+    } else {
+        devices.assign(count, RtAudio::DeviceInfo());
+    }
+
+    //devices that were busy or absent from the cache are probed now
+    std::vector<unsigned int> pending;
+    for (unsigned int i = 0; i < count; i++) {
+        if (!devices[i].probed) pending.push_back(i);
+    }
+    //even a single device goes to a worker, a hung card must not stall the caller
+    if (!pending.empty()) probeParallel(api, pending, devices);
+    for (auto i : pending) changed = changed || devices[i].probed;
+
+    if (changed && !fingerprint.empty()) storeCache(api, fingerprint, devices);
+
+    results.fingerprint = fingerprint;
+    results.count = count;
+    results.devices.swap(devices);
+    return results.devices;
+}
+
+std::vector<RtAudio::DeviceInfo> audioProbeDevices(RtAudio &dac) {
+    std::lock_guard<std::mutex> lock(probeMutex);
+    return probeDevices(dac);
+}
+
+std::vector<RtAudio::DeviceInfo> audioProbeDevices(RtAudio::Api api) {
+    std::lock_guard<std::mutex> lock(probeMutex);
+
+    //enumeration handles live as long as the module, the backend is set up once
+    std::unique_ptr<RtAudio> &handle = probeHandles[api];
+    if (!handle) handle.reset(new RtAudio(api));
+    return probeDevices(*handle);
+}
+
+RtAudio::DeviceInfo audioProbeDevice(RtAudio &dac, unsigned int device) {
+    std::lock_guard<std::mutex> lock(probeMutex);
+
+    const std::vector<RtAudio::DeviceInfo> &devices = probeDevices(dac);
+    if (device < devices.size()) return devices[device];
+    return dac.getDeviceInfo(device);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <RtAudio.h>
+#include <string>
+#include <vector>
+
+//cache format version, bump when the stored fields change
+#define AUDIO_DEVICE_CACHE_VERSION 1
+
+//devices probed concurrently, and how long a single probe may block
+//before the device is left out of the results
+#define AUDIO_PROBE_THREADS 4
+#define AUDIO_PROBE_TIMEOUT_MS 3000
+
+//sound server device lists are reused for this long, clients poll listSampleRates
+#define AUDIO_SERVER_REFRESH_MS 1000
+
+//probing is slow on some backends, ALSA opens every PCM at every standard rate,
+//so results are shared within the process and kept on disk between processes,
+//both are reused until a hot-plug changes the attached hardware
+
+//identifies the attached hardware for the backend, empty when it cannot be
+//determined cheaply, in which case nothing is cached
+std::string audioDeviceFingerprint(RtAudio::Api api);
+
+//info for every device of the backend dac was created for
+std::vector<RtAudio::DeviceInfo> audioProbeDevices(RtAudio &dac);
+
+//same through a process-wide handle, so find calls do not set up the backend again
+std::vector<RtAudio::DeviceInfo> audioProbeDevices(RtAudio::Api api = RtAudio::UNSPECIFIED);
+
+//info for a single device, from the shared results when they are current
+RtAudio::DeviceInfo audioProbeDevice(RtAudio &dac, unsigned int device);
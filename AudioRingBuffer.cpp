@@ -0,0 +1,61 @@
+#include "AudioRingBuffer.h"
+
+AudioRingBuffer::AudioRingBuffer() {
+    writeCount.store(0);
+    readCount.store(0);
+}
+
+void AudioRingBuffer::configure(size_t numSlots, size_t slotSize) {
+    slots.assign(numSlots, std::vector<float>(slotSize, 0.0f));
+    lengths.assign(numSlots, 0);
+    clear();
+}
+
+void AudioRingBuffer::clear() {
+    writeCount.store(0);
+    readCount.store(0);
+}
+
+size_t AudioRingBuffer::getNumSlots() const {
+    return slots.size();
+}
+
+size_t AudioRingBuffer::getSlotSize() const {
+    return slots.empty() ? 0 : slots[0].size();
+}
+
+float *AudioRingBuffer::getSlot(size_t handle) {
+    return slots[handle].data();
+}
+
+bool AudioRingBuffer::acquireWrite(size_t &handle) {
+    const size_t written = writeCount.load(std::memory_order_relaxed);
+    if (written - readCount.load(std::memory_order_acquire) >= slots.size()) {
+        return false;
+    }
+    handle = written % slots.size();
+    return true;
+}
+
+void AudioRingBuffer::releaseWrite(size_t handle, size_t numFloats) {
+    lengths[handle] = numFloats;
+    writeCount.fetch_add(1, std::memory_order_release);
+}
+
+bool AudioRingBuffer::acquireRead(size_t &handle, size_t &numFloats) {
+    const size_t consumed = readCount.load(std::memory_order_relaxed);
+    if (consumed == writeCount.load(std::memory_order_acquire)) {
+        return false;
+    }
+    handle = consumed % slots.size();
+    numFloats = lengths[handle];
+    return true;
+}
+
+void AudioRingBuffer::releaseRead(size_t handle) {
+    readCount.fetch_add(1, std::memory_order_release);
+}
+
+size_t AudioRingBuffer::getNumQueued() const {
+    return writeCount.load(std::memory_order_acquire) - readCount.load(std::memory_order_acquire);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+//single producer, single consumer queue of fixed size sample buffers,
+//neither side locks so the consumer can live in a realtime callback
+class AudioRingBuffer {
+public:
+    AudioRingBuffer();
+
+    //slotSize is in floats
+    void configure(size_t numSlots, size_t slotSize);
+    void clear();
+
+    size_t getNumSlots() const;
+    size_t getSlotSize() const;
+    float *getSlot(size_t handle);
+
+    //producer side, acquire fails when every slot is queued
+    bool acquireWrite(size_t &handle);
+    void releaseWrite(size_t handle, size_t numFloats);
+
+    //consumer side, acquire fails when nothing is queued
+    bool acquireRead(size_t &handle, size_t &numFloats);
+    void releaseRead(size_t handle);
+
+    size_t getNumQueued() const;
+
+private:
+    std::vector<std::vector<float> > slots;
+    std::vector<size_t> lengths;
+    std::atomic<size_t> writeCount, readCount;
+};
@@ -23,23 +23,35 @@
  */
 
 #include "SoapyAudio.hpp"
+#include "AudioDeviceCache.h"
 #include <SoapySDR/Registry.hpp>
 #include <cstdlib> //malloc
 
-static std::vector<SoapySDR::Kwargs> findAudio(const SoapySDR::Kwargs &args)
+//devices of one backend, a device_id list yields a single aggregate device
+static std::vector<SoapySDR::Kwargs> findAudioDevices(RtAudio::Api api, const SoapySDR::Kwargs &args, bool labelApi)
 {
     std::vector<SoapySDR::Kwargs> results;
 
-    RtAudio endac;
+    //a list of ids is matched as one aggregate device
+    std::vector<int> deviceIds;
+    if (args.count("device_id") != 0)
+    {
+        deviceIds = SoapyAudio::deviceIdStrToList(args.at("device_id"));
+    }
+    const bool aggregate = deviceIds.size() > 1;
 
-    int numDevices = endac.getDeviceCount();
+    //probed once per hardware change, later calls read the cache
+    std::vector<RtAudio::DeviceInfo> devices = audioProbeDevices(api);
+    int numDevices = devices.size();
 
     for (int i = 0; i < numDevices; i++) {
-        RtAudio::DeviceInfo info = endac.getDeviceInfo(i);
+        const RtAudio::DeviceInfo &info = devices[i];
         SoapySDR::Kwargs soapyInfo;
 
+        soapyInfo["api"] = RtAudio::getApiName(api);
         soapyInfo["device_id"] = std::to_string(i);
         soapyInfo["label"] = info.name;
+        if (labelApi) soapyInfo["label"] += " [" + RtAudio::getApiDisplayName(api) + "]";
         soapyInfo["default_output"] = info.isDefaultOutput ? "True" : "False";
         soapyInfo["default_input"] = info.isDefaultInput ? "True" : "False";
 
@@ -73,7 +85,14 @@ static std::vector<SoapySDR::Kwargs> findAudio(const SoapySDR::Kwargs &args)
             continue;
         }
         
-        if (args.count("device_id") != 0)
+        if (aggregate)
+        {
+            if (std::find(deviceIds.begin(), deviceIds.end(), i) == deviceIds.end())
+            {
+                continue;
+            }
+        }
+        else if (args.count("device_id") != 0)
         {
             if (args.at("device_id") != soapyInfo.at("device_id"))
             {
@@ -84,6 +103,60 @@ static std::vector<SoapySDR::Kwargs> findAudio(const SoapySDR::Kwargs &args)
         
         results.push_back(soapyInfo);
     }
+
+    if (aggregate)
+    {
+        //every listed card must be present, in the order given
+        SoapySDR::Kwargs soapyInfo;
+        std::string label;
+        bool complete = true;
+        for (auto id : deviceIds)
+        {
+            auto it = std::find_if(results.begin(), results.end(), [id](const SoapySDR::Kwargs &r) {
+                return r.at("device_id") == std::to_string(id);
+            });
+            if (it == results.end())
+            {
+                complete = false;
+                break;
+            }
+            label += (label.empty() ? "" : " + ") + it->at("label");
+        }
+        results.clear();
+        if (complete)
+        {
+            soapyInfo["api"] = RtAudio::getApiName(api);
+            soapyInfo["device_id"] = args.at("device_id");
+            soapyInfo["label"] = label;
+            results.push_back(soapyInfo);
+            SoapySDR_logf(SOAPY_SDR_DEBUG, "Found aggregate device by device_id %s", soapyInfo.at("device_id").c_str());
+        }
+    }
+
+    return results;
+}
+
+static std::vector<SoapySDR::Kwargs> findAudio(const SoapySDR::Kwargs &args)
+{
+    std::vector<SoapySDR::Kwargs> results;
+
+    //each compiled backend is listed on its own, api= limits the search to one
+    std::vector<RtAudio::Api> apis;
+    if (args.count("api") != 0)
+    {
+        RtAudio::Api api = RtAudio::getCompiledApiByName(args.at("api"));
+        if (api != RtAudio::UNSPECIFIED) apis.push_back(api);
+    }
+    else
+    {
+        RtAudio::getCompiledApi(apis);
+    }
+
+    for (auto api : apis)
+    {
+        std::vector<SoapySDR::Kwargs> apiResults = findAudioDevices(api, args, apis.size() > 1);
+        results.insert(results.end(), apiResults.begin(), apiResults.end());
+    }
     
 #ifdef USE_HAMLIB
 	rig_set_debug(RIG_DEBUG_ERR);
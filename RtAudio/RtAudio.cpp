@@ -77,12 +77,14 @@ const unsigned int RtApi::SAMPLE_RATES[] = {
     return s;
   }
 
-#elif defined(__LINUX_ALSA__) || defined(__LINUX_PULSE__) || defined(__UNIX_JACK__) || defined(__LINUX_OSS__) || defined(__MACOSX_CORE__)
+#elif defined(__LINUX_ALSA__) || defined(__LINUX_PULSE__) || defined(__LINUX_PIPEWIRE__) || defined(__UNIX_JACK__) || defined(__LINUX_OSS__) || defined(__MACOSX_CORE__)
   // pthread API
   #define MUTEX_INITIALIZE(A) pthread_mutex_init(A, NULL)
   #define MUTEX_DESTROY(A)    pthread_mutex_destroy(A)
   #define MUTEX_LOCK(A)       pthread_mutex_lock(A)
   #define MUTEX_UNLOCK(A)     pthread_mutex_unlock(A)
+
+  #include <sys/mman.h>
 #else
   #define MUTEX_INITIALIZE(A) abs(*A) // dummy definitions
   #define MUTEX_DESTROY(A)    abs(*A) // dummy definitions
@@ -113,6 +115,7 @@ const char* rtaudio_api_names[][2] = {
   { "asio"        , "ASIO" },
   { "ds"          , "DirectSound" },
   { "dummy"       , "Dummy" },
+  { "pipewire"    , "PipeWire" },
 };
 const unsigned int rtaudio_num_api_names = 
   sizeof(rtaudio_api_names)/sizeof(rtaudio_api_names[0]);
@@ -131,6 +134,10 @@ extern "C" const RtAudio::Api rtaudio_compiled_apis[] = {
 #endif
 #if defined(__LINUX_OSS__)
   RtAudio::LINUX_OSS,
+#endif
+  // Capture only, so never the implicit choice over a full duplex API.
+#if defined(__LINUX_PIPEWIRE__)
+  RtAudio::LINUX_PIPEWIRE,
 #endif
 #if defined(__WINDOWS_ASIO__)
   RtAudio::WINDOWS_ASIO,
@@ -208,6 +215,10 @@ void RtAudio :: openRtApi( RtAudio::Api api )
   if ( api == LINUX_PULSE )
     rtapi_ = new RtApiPulse();
 #endif
+#if defined(__LINUX_PIPEWIRE__)
+  if ( api == LINUX_PIPEWIRE )
+    rtapi_ = new RtApiPipeWire();
+#endif
 #if defined(__LINUX_OSS__)
   if ( api == LINUX_OSS )
     rtapi_ = new RtApiOss();
@@ -401,6 +412,50 @@ void RtApi :: openStream( RtAudio::StreamParameters *oParams,
 
   if ( options ) options->numberOfBuffers = stream_.nBuffers;
   stream_.state = STREAM_STOPPED;
+
+  if ( options && options->flags & RTAUDIO_LOCK_MEMORY ) {
+    stream_.memoryLocked = lockStreamBuffers( true );
+    if ( !stream_.memoryLocked ) {
+      lockStreamBuffers( false );
+      errorText_ = "RtApi::openStream: error locking the stream buffers into memory.";
+      error( RtAudioError::WARNING );
+    }
+  }
+}
+
+bool RtApi :: lockStreamBuffers( bool lock )
+{
+  // Sized as probeDeviceOpen() allocates them, the device buffer is
+  // shared by both directions and holds the larger of the two.
+  char *buffers[3] = { stream_.userBuffer[0], stream_.userBuffer[1], stream_.deviceBuffer };
+  size_t bytes[3] = { 0, 0, 0 };
+  for ( int i=0; i<2; i++ ) {
+    bytes[i] = (size_t) stream_.nUserChannels[i] * stream_.bufferSize * formatBytes( stream_.userFormat );
+    if ( stream_.doConvertBuffer[i] )
+      bytes[2] = std::max( bytes[2], (size_t) stream_.nDeviceChannels[i] * stream_.bufferSize * formatBytes( stream_.deviceFormat[i] ) );
+  }
+
+  bool result = true;
+  for ( int i=0; i<3; i++ ) {
+    if ( buffers[i] == 0 || bytes[i] == 0 ) continue;
+#if defined(__WINDOWS_DS__) || defined(__WINDOWS_ASIO__) || defined(__WINDOWS_WASAPI__)
+    if ( lock ) result = VirtualLock( buffers[i], bytes[i] ) && result;
+    else VirtualUnlock( buffers[i], bytes[i] );
+#elif defined(__LINUX_ALSA__) || defined(__LINUX_PULSE__) || defined(__LINUX_PIPEWIRE__) || defined(__UNIX_JACK__) || defined(__LINUX_OSS__) || defined(__MACOSX_CORE__)
+    if ( lock ) result = mlock( buffers[i], bytes[i] ) == 0 && result;
+    else munlock( buffers[i], bytes[i] );
+#else
+    result = false;
+#endif
+  }
+  return result;
+}
+
+void RtApi :: unlockStreamMemory( void )
+{
+  if ( !stream_.memoryLocked ) return;
+  lockStreamBuffers( false );
+  stream_.memoryLocked = false;
 }
 
 unsigned int RtApi :: getDefaultInputDevice( void )
@@ -1992,6 +2047,7 @@ const char* RtApiCore :: getErrorCode( OSStatus code )
 #include <jack/jack.h>
 #include <unistd.h>
 #include <cstdio>
+#include <cerrno>
 
 // A structure to hold various information related to the Jack API
 // implementation.
@@ -2003,9 +2059,12 @@ struct JackHandle {
   pthread_cond_t condition;
   int drainCounter;       // Tracks callback counts when draining
   bool internalDrain;     // Indicates if stop is initiated from callback or not.
+  std::vector<std::string> sourcePorts; // Explicit capture connections, in channel order.
+  bool portBuffers;       // Input port buffers are passed to the callback in place.
+  std::vector<jack_default_audio_sample_t *> inputBuffers;
 
   JackHandle()
-    :client(0), drainCounter(0), internalDrain(false) { ports[0] = 0; ports[1] = 0; xrun[0] = false; xrun[1] = false; }
+    :client(0), drainCounter(0), internalDrain(false), portBuffers(false) { ports[0] = 0; ports[1] = 0; xrun[0] = false; xrun[1] = false; }
 };
 
 #if !defined(__RTAUDIO_DEBUG__)
@@ -2259,7 +2318,27 @@ bool RtApiJack :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
   unsigned long flag = JackPortIsInput;
   if ( mode == INPUT ) flag = JackPortIsOutput;
 
-  if ( ! (options && (options->flags & RTAUDIO_JACK_DONT_CONNECT)) ) {
+  // Explicit capture ports replace the ports of the device.
+  std::vector<std::string> sourcePorts;
+  if ( mode == INPUT && options ) sourcePorts = options->jackPorts;
+  if ( !sourcePorts.empty() ) {
+    if ( sourcePorts.size() < channels + firstChannel ) {
+      errorStream_ << "RtApiJack::probeDeviceOpen: requested number of channels (" << channels << ") + offset (" << firstChannel << ") exceeds the " << sourcePorts.size() << " ports given.";
+      errorText_ = errorStream_.str();
+      if ( handle == 0 ) jack_client_close( client );
+      return FAILURE;
+    }
+    for ( unsigned int i=0; i<sourcePorts.size(); i++ ) {
+      jack_port_t *source = jack_port_by_name( client, sourcePorts[i].c_str() );
+      if ( source == NULL || !( jack_port_flags( source ) & JackPortIsOutput ) ) {
+        errorStream_ << "RtApiJack::probeDeviceOpen: port (" << sourcePorts[i] << ") is not a JACK output port.";
+        errorText_ = errorStream_.str();
+        if ( handle == 0 ) jack_client_close( client );
+        return FAILURE;
+      }
+    }
+  }
+  else if ( ! (options && (options->flags & RTAUDIO_JACK_DONT_CONNECT)) ) {
     // Count the available ports containing the client name as device
     // channels.  Jack "input ports" equal RtAudio output channels.
     unsigned int nChannels = 0;
@@ -2276,9 +2355,9 @@ bool RtApiJack :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
     }
   }
 
-  // Check the jack server sample rate.
+  // Check the jack server sample rate, the stream may adopt it.
   unsigned int jackRate = jack_get_sample_rate( client );
-  if ( sampleRate != jackRate ) {
+  if ( sampleRate != jackRate && !( options && options->flags & RTAUDIO_JACK_SERVER_RATE ) ) {
     jack_client_close( client );
     errorStream_ << "RtApiJack::probeDeviceOpen: the requested sample rate (" << sampleRate << ") is different than the JACK server rate (" << jackRate << ").";
     errorText_ = errorStream_.str();
@@ -2287,19 +2366,25 @@ bool RtApiJack :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
   stream_.sampleRate = jackRate;
 
   // Get the latency of the JACK port.
-  ports = jack_get_ports( client, deviceName.c_str(), JACK_DEFAULT_AUDIO_TYPE, flag );
-  if ( ports[ firstChannel ] ) {
+  jack_port_t *latencyPort = NULL;
+  if ( !sourcePorts.empty() )
+    latencyPort = jack_port_by_name( client, sourcePorts[firstChannel].c_str() );
+  else {
+    ports = jack_get_ports( client, deviceName.c_str(), JACK_DEFAULT_AUDIO_TYPE, flag );
+    if ( ports && ports[ firstChannel ] )
+      latencyPort = jack_port_by_name( client, ports[firstChannel] );
+    free( ports );
+  }
+  if ( latencyPort ) {
     // Added by Ge Wang
     jack_latency_callback_mode_t cbmode = (mode == INPUT ? JackCaptureLatency : JackPlaybackLatency);
     // the range (usually the min and max are equal)
     jack_latency_range_t latrange; latrange.min = latrange.max = 0;
     // get the latency range
-    jack_port_get_latency_range( jack_port_by_name( client, ports[firstChannel] ), cbmode, &latrange );
+    jack_port_get_latency_range( latencyPort, cbmode, &latrange );
     // be optimistic, use the min!
     stream_.latency[mode] = latrange.min;
-    //stream_.latency[mode] = jack_port_get_latency( jack_port_by_name( client, ports[ firstChannel ] ) );
   }
-  free( ports );
 
   // The jack server always uses 32-bit floating-point data.
   stream_.deviceFormat[mode] = RTAUDIO_FLOAT32;
@@ -2330,6 +2415,11 @@ bool RtApiJack :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
        stream_.nUserChannels[mode] > 1 )
     stream_.doConvertBuffer[mode] = true;
 
+  // Port buffers handed over in place need neither conversion nor a copy.
+  bool portBuffers = mode == INPUT && stream_.mode != OUTPUT && format == RTAUDIO_FLOAT32 &&
+    options && ( options->flags & RTAUDIO_JACK_PORT_BUFFERS );
+  if ( portBuffers ) stream_.doConvertBuffer[mode] = false;
+
   // Allocate our JackHandle structure for the stream.
   if ( handle == 0 ) {
     try {
@@ -2348,6 +2438,11 @@ bool RtApiJack :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
     handle->client = client;
   }
   handle->deviceName[mode] = deviceName;
+  if ( mode == INPUT ) {
+    handle->sourcePorts = sourcePorts;
+    handle->portBuffers = portBuffers;
+    handle->inputBuffers.assign( channels, (jack_default_audio_sample_t *) 0 );
+  }
 
   // Allocate necessary internal buffers.
   unsigned long bufferBytes;
@@ -2545,7 +2640,19 @@ void RtApiJack :: startStream( void )
     free(ports);
   }
 
-  if ( shouldAutoconnect_ && (stream_.mode == INPUT || stream_.mode == DUPLEX) ) {
+  // Explicit capture ports are connected even without autoconnect.
+  if ( !handle->sourcePorts.empty() && (stream_.mode == INPUT || stream_.mode == DUPLEX) ) {
+    for ( unsigned int i=0; i<stream_.nUserChannels[1]; i++ ) {
+      result = jack_connect( handle->client, handle->sourcePorts[ stream_.channelOffset[1] + i ].c_str(), jack_port_name( handle->ports[1][i] ) );
+      if ( result && result != EEXIST ) {
+        errorStream_ << "RtApiJack::startStream(): error connecting input port (" << handle->sourcePorts[ stream_.channelOffset[1] + i ] << ")!";
+        errorText_ = errorStream_.str();
+        goto unlock;
+      }
+      result = 0;
+    }
+  }
+  else if ( shouldAutoconnect_ && (stream_.mode == INPUT || stream_.mode == DUPLEX) ) {
     result = 1;
     ports = jack_get_ports( handle->client, handle->deviceName[1].c_str(), JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput );
     if ( ports == NULL) {
@@ -2669,7 +2776,13 @@ bool RtApiJack :: callbackEvent( unsigned long nframes )
       status |= RTAUDIO_INPUT_OVERFLOW;
       handle->xrun[1] = false;
     }
-    int cbReturnValue = callback( stream_.userBuffer[0], stream_.userBuffer[1],
+    void *inputBuffer = stream_.userBuffer[1];
+    if ( handle->portBuffers ) {
+      for ( unsigned int i=0; i<stream_.nUserChannels[1]; i++ )
+        handle->inputBuffers[i] = (jack_default_audio_sample_t *) jack_port_get_buffer( handle->ports[1][i], (jack_nframes_t) nframes );
+      inputBuffer = (void *) &handle->inputBuffers[0];
+    }
+    int cbReturnValue = callback( stream_.userBuffer[0], inputBuffer,
                                   stream_.bufferSize, streamTime, status, info->userData );
     if ( cbReturnValue == 2 ) {
       stream_.state = STREAM_STOPPING;
@@ -2719,9 +2832,20 @@ bool RtApiJack :: callbackEvent( unsigned long nframes )
     goto unlock;
   }
 
+  if ( handle->portBuffers ) goto unlock; // the callback read the ports in place
+
   if ( stream_.mode == INPUT || stream_.mode == DUPLEX ) {
 
-    if ( stream_.doConvertBuffer[1] ) {
+    if ( stream_.doConvertBuffer[1] && stream_.userFormat == RTAUDIO_FLOAT32 ) {
+      // Only the interleaving is left, done straight from the ports.
+      jack_default_audio_sample_t *out = (jack_default_audio_sample_t *) stream_.userBuffer[1];
+      unsigned int nChannels = stream_.nUserChannels[1];
+      for ( unsigned int i=0; i<nChannels; i++ ) {
+        jackbuffer = (jack_default_audio_sample_t *) jack_port_get_buffer( handle->ports[1][i], (jack_nframes_t) nframes );
+        for ( unsigned long j=0; j<nframes; j++ ) out[j*nChannels + i] = jackbuffer[j];
+      }
+    }
+    else if ( stream_.doConvertBuffer[1] ) {
       for ( unsigned int i=0; i<stream_.nDeviceChannels[1]; i++ ) {
         jackbuffer = (jack_default_audio_sample_t *) jack_port_get_buffer( handle->ports[1][i], (jack_nframes_t) nframes );
         memcpy( &stream_.deviceBuffer[i*bufferBytes], jackbuffer, bufferBytes );
@@ -7115,6 +7239,9 @@ static const char* getErrorString( int code )
 
 #include <alsa/asoundlib.h>
 #include <unistd.h>
+#include <poll.h>
+#include <cerrno>
+#include <vector>
 
   // A structure to hold various information related to the ALSA API
   // implementation.
@@ -7122,11 +7249,15 @@ struct AlsaHandle {
   snd_pcm_t *handles[2];
   bool synchronized;
   bool xrun[2];
+  bool mmap[2];
+  bool poll;
+  int pollTimeout;
+  std::vector<struct pollfd> pollFds;
   pthread_cond_t runnable_cv;
   bool runnable;
 
   AlsaHandle()
-    :synchronized(false), runnable(false) { xrun[0] = false; xrun[1] = false; }
+    :synchronized(false), poll(false), pollTimeout(-1), runnable(false) { xrun[0] = false; xrun[1] = false; mmap[0] = false; mmap[1] = false; }
 };
 
 static void *alsaCallbackHandler( void * ptr );
@@ -7526,7 +7657,10 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
         if ( result < 0 ) break;
         if ( subdevice < 0 ) break;
         if ( nDevices == device ) {
-          sprintf( name, "hw:%d,%d", card, subdevice );
+          if ( options && options->flags & RTAUDIO_ALSA_USE_PLUG )
+            sprintf( name, "plughw:%d,%d", card, subdevice );
+          else
+            sprintf( name, "hw:%d,%d", card, subdevice );
           snd_ctl_close( chandle );
           goto foundDevice;
         }
@@ -7574,17 +7708,28 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
   else
     stream = SND_PCM_STREAM_CAPTURE;
 
+  // Exclusive use means the card itself, without plug, dmix or dsnoop
+  // in between, and a busy card is reported instead of waited for.
+  bool hogDevice = options && options->flags & RTAUDIO_HOG_DEVICE;
+  if ( hogDevice && strncmp( name, "hw:", 3 ) != 0 ) {
+    errorStream_ << "RtApiAlsa::probeDeviceOpen: pcm device (" << name << ") cannot be opened for exclusive use.";
+    errorText_ = errorStream_.str();
+    return FAILURE;
+  }
+
   snd_pcm_t *phandle;
   int openMode = SND_PCM_ASYNC;
+  if ( hogDevice ) openMode |= SND_PCM_NONBLOCK;
   result = snd_pcm_open( &phandle, name, stream, openMode );
   if ( result < 0 ) {
     if ( mode == OUTPUT )
-      errorStream_ << "RtApiAlsa::probeDeviceOpen: pcm device (" << name << ") won't open for output.";
+      errorStream_ << "RtApiAlsa::probeDeviceOpen: pcm device (" << name << ") won't open for output, " << snd_strerror( result ) << ".";
     else
-      errorStream_ << "RtApiAlsa::probeDeviceOpen: pcm device (" << name << ") won't open for input.";
+      errorStream_ << "RtApiAlsa::probeDeviceOpen: pcm device (" << name << ") won't open for input, " << snd_strerror( result ) << ".";
     errorText_ = errorStream_.str();
     return FAILURE;
   }
+  if ( hogDevice ) snd_pcm_nonblock( phandle, 0 );
 
   // Fill the parameter structure.
   snd_pcm_hw_params_t *hw_params;
@@ -7603,7 +7748,26 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
 #endif
 
   // Set access ... check user preference.
-  if ( options && options->flags & RTAUDIO_NONINTERLEAVED ) {
+  bool useMmap = false;
+  if ( mode == INPUT && options && options->flags & RTAUDIO_ALSA_USE_MMAP ) {
+    // The DMA area is read in place, the conversion step handles any user layout.
+    stream_.userInterleaved = !( options->flags & RTAUDIO_NONINTERLEAVED );
+    result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_MMAP_INTERLEAVED );
+    if ( result == 0 ) {
+      stream_.deviceInterleaved[mode] = true;
+      useMmap = true;
+    }
+    else {
+      errorStream_ << "RtApiAlsa::probeDeviceOpen: pcm device (" << name << ") has no mmap access, using read/write access.";
+      errorText_ = errorStream_.str();
+      error( RtAudioError::WARNING );
+    }
+  }
+
+  if ( useMmap ) {
+    // Access is already set.
+  }
+  else if ( options && options->flags & RTAUDIO_NONINTERLEAVED ) {
     stream_.userInterleaved = false;
     result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_RW_NONINTERLEAVED );
     if ( result < 0 ) {
@@ -7822,6 +7986,14 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
   // The following two settings were suggested by Theo Veenker
   //snd_pcm_sw_params_set_avail_min( phandle, sw_params, *bufferSize );
   //snd_pcm_sw_params_set_xfer_align( phandle, sw_params, 1 );
+  if ( options && options->availMin > 0 ) {
+    result = snd_pcm_sw_params_set_avail_min( phandle, sw_params, options->availMin );
+    if ( result < 0 ) {
+      errorStream_ << "RtApiAlsa::probeDeviceOpen: avail_min of " << options->availMin << " not accepted by device (" << name << "), " << snd_strerror( result ) << ".";
+      errorText_ = errorStream_.str();
+      error( RtAudioError::WARNING );
+    }
+  }
 
   // here are two options for a fix
   //snd_pcm_sw_params_set_silence_size( phandle, sw_params, ULONG_MAX );
@@ -7837,6 +8009,12 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
     return FAILURE;
   }
 
+  // Report the threshold actually in effect.
+  if ( options ) {
+    snd_pcm_uframes_t availMin = 0;
+    if ( snd_pcm_sw_params_get_avail_min( sw_params, &availMin ) == 0 ) options->availMin = availMin;
+  }
+
 #if defined(__RTAUDIO_DEBUG__)
   fprintf(stderr, "\nRtApiAlsa: dump software params after installation:\n\n");
   snd_pcm_sw_params_dump( sw_params, out );
@@ -7876,6 +8054,25 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
     apiInfo = (AlsaHandle *) stream_.apiHandle;
   }
   apiInfo->handles[mode] = phandle;
+  apiInfo->mmap[mode] = useMmap;
+
+  // Poll driven capture, input only streams with an interleaved layout.
+  apiInfo->poll = false;
+  if ( mode == INPUT && stream_.mode != OUTPUT && options && options->flags & RTAUDIO_ALSA_POLL_CAPTURE ) {
+    int nfds = snd_pcm_poll_descriptors_count( phandle );
+    if ( !stream_.userInterleaved || !stream_.deviceInterleaved[mode] || nfds <= 0 ) {
+      errorStream_ << "RtApiAlsa::probeDeviceOpen: poll capture not available on device (" << name << "), using blocking reads.";
+      errorText_ = errorStream_.str();
+      error( RtAudioError::WARNING );
+    }
+    else {
+      apiInfo->pollFds.resize( nfds );
+      snd_pcm_poll_descriptors( phandle, &apiInfo->pollFds[0], nfds );
+      // Long enough for two periods, a missed wakeup is retried rather than fatal.
+      apiInfo->pollTimeout = std::max( 10, (int) ( 2000.0 * *bufferSize / sampleRate ) );
+      apiInfo->poll = true;
+    }
+  }
   phandle = 0;
 
   // Allocate necessary internal buffers.
@@ -8225,6 +8422,11 @@ void RtApiAlsa :: callbackEvent()
     return;
   }
 
+  if ( apiInfo->poll ) {
+    pollCapture();
+    return;
+  }
+
   int doStopStream = 0;
   RtAudioCallback callback = (RtAudioCallback) stream_.callbackInfo.callback;
   double streamTime = getStreamTime();
@@ -8272,8 +8474,14 @@ void RtApiAlsa :: callbackEvent()
       format = stream_.userFormat;
     }
 
+    // Convert straight out of the DMA area when no byte swap is in the way.
+    bool converted = false;
+    if ( apiInfo->mmap[1] ) {
+      converted = stream_.doConvertBuffer[1] && !stream_.doByteSwap[1];
+      result = mmapCapture( handle[1], converted, stream_.bufferSize );
+    }
     // Read samples from device in interleaved/non-interleaved format.
-    if ( stream_.deviceInterleaved[1] )
+    else if ( stream_.deviceInterleaved[1] )
       result = snd_pcm_readi( handle[1], buffer, stream_.bufferSize );
     else {
       void *bufs[channels];
@@ -8313,7 +8521,7 @@ void RtApiAlsa :: callbackEvent()
       byteSwapBuffer( buffer, stream_.bufferSize * channels, format );
 
     // Do buffer conversion if necessary.
-    if ( stream_.doConvertBuffer[1] )
+    if ( stream_.doConvertBuffer[1] && !converted )
       convertBuffer( stream_.userBuffer[1], stream_.deviceBuffer, stream_.convertInfo[1] );
 
     // Check stream latency
@@ -8392,6 +8600,159 @@ void RtApiAlsa :: callbackEvent()
   if ( doStopStream == 1 ) this->stopStream();
 }
 
+int RtApiAlsa :: mmapCapture( snd_pcm_t *handle, bool convert, unsigned long count )
+{
+  // Transfers count frames from the mmap'ed ring, either converted
+  // into the user buffer or copied into the buffer the read path would use.
+  // Returns the frame count like snd_pcm_readi, or a negative error code.
+  char *buffer = stream_.doConvertBuffer[1] ? stream_.deviceBuffer : stream_.userBuffer[1];
+  unsigned int deviceFrameBytes = stream_.nDeviceChannels[1] * formatBytes( stream_.deviceFormat[1] );
+  unsigned int userFrameBytes = formatBytes( stream_.userFormat ) * ( stream_.userInterleaved ? stream_.nUserChannels[1] : 1 );
+  snd_pcm_uframes_t done = 0;
+
+  while ( done < count ) {
+    // Capture does not start itself on mmap access.
+    if ( snd_pcm_state( handle ) == SND_PCM_STATE_PREPARED ) {
+      int result = snd_pcm_start( handle );
+      if ( result < 0 ) return result;
+    }
+
+    snd_pcm_sframes_t avail = snd_pcm_avail_update( handle );
+    if ( avail < 0 ) return (int) avail;
+    if ( avail == 0 ) {
+      int result = snd_pcm_wait( handle, 1000 );
+      if ( result < 0 ) return result;
+      if ( result == 0 ) return -EIO;
+      continue;
+    }
+
+    const snd_pcm_channel_area_t *areas;
+    snd_pcm_uframes_t offset;
+    snd_pcm_uframes_t frames = count - done;
+    int result = snd_pcm_mmap_begin( handle, &areas, &offset, &frames );
+    if ( result < 0 ) return result;
+
+    char *area = (char *) areas[0].addr + ( areas[0].first + offset * areas[0].step ) / 8;
+    if ( convert )
+      convertBuffer( stream_.userBuffer[1] + done * userFrameBytes, area, stream_.convertInfo[1], frames );
+    else
+      memcpy( buffer + done * deviceFrameBytes, area, frames * deviceFrameBytes );
+
+    snd_pcm_sframes_t committed = snd_pcm_mmap_commit( handle, offset, frames );
+    if ( committed < 0 ) return (int) committed;
+    if ( (snd_pcm_uframes_t) committed != frames ) return -EPIPE;
+    done += frames;
+  }
+
+  return (int) done;
+}
+
+void RtApiAlsa :: pollCapture()
+{
+  // Waits on the poll descriptors rather than in a read, then hands
+  // everything available, up to one buffer, to the callback.
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
+  snd_pcm_t *handle = apiInfo->handles[1];
+  snd_pcm_sframes_t frames = 0;
+  int result = 0;
+
+  MUTEX_LOCK( &stream_.mutex );
+
+  // The state might change while waiting on a mutex.
+  if ( stream_.state == STREAM_STOPPED ) {
+    MUTEX_UNLOCK( &stream_.mutex );
+    return;
+  }
+
+  // Capture does not start itself until something reads.
+  if ( snd_pcm_state( handle ) == SND_PCM_STATE_PREPARED )
+    result = snd_pcm_start( handle );
+
+  if ( result >= 0 ) {
+    result = poll( &apiInfo->pollFds[0], apiInfo->pollFds.size(), apiInfo->pollTimeout );
+    if ( result < 0 )
+      result = ( errno == EINTR ) ? 0 : -errno;
+    else if ( result > 0 ) {
+      unsigned short revents = 0;
+      snd_pcm_poll_descriptors_revents( handle, &apiInfo->pollFds[0], apiInfo->pollFds.size(), &revents );
+      result = ( revents & POLLERR ) ? -EPIPE : 0;
+    }
+  }
+
+  if ( result >= 0 ) {
+    frames = snd_pcm_avail_update( handle );
+    if ( frames < 0 ) result = (int) frames;
+  }
+
+  if ( result >= 0 && frames > 0 ) {
+    if ( frames > (snd_pcm_sframes_t) stream_.bufferSize ) frames = stream_.bufferSize;
+    char *buffer = stream_.doConvertBuffer[1] ? stream_.deviceBuffer : stream_.userBuffer[1];
+    int channels = stream_.doConvertBuffer[1] ? stream_.nDeviceChannels[1] : stream_.nUserChannels[1];
+    RtAudioFormat format = stream_.doConvertBuffer[1] ? stream_.deviceFormat[1] : stream_.userFormat;
+
+    bool converted = false;
+    if ( apiInfo->mmap[1] ) {
+      converted = stream_.doConvertBuffer[1] && !stream_.doByteSwap[1];
+      result = mmapCapture( handle, converted, frames );
+    }
+    else
+      result = snd_pcm_readi( handle, buffer, frames );
+
+    if ( result == frames ) {
+      result = 0;
+      if ( stream_.doByteSwap[1] )
+        byteSwapBuffer( buffer, frames * channels, format );
+      if ( stream_.doConvertBuffer[1] && !converted )
+        convertBuffer( stream_.userBuffer[1], stream_.deviceBuffer, stream_.convertInfo[1], frames );
+
+      snd_pcm_sframes_t delay;
+      if ( snd_pcm_delay( handle, &delay ) == 0 && delay > 0 ) stream_.latency[1] = delay;
+    }
+    else if ( result >= 0 )
+      result = -EIO;
+  }
+
+  if ( result == -EPIPE && snd_pcm_state( handle ) == SND_PCM_STATE_XRUN ) {
+    apiInfo->xrun[1] = true;
+    result = snd_pcm_prepare( handle );
+    if ( result < 0 ) {
+      errorStream_ << "RtApiAlsa::pollCapture: error preparing device after overrun, " << snd_strerror( result ) << ".";
+      errorText_ = errorStream_.str();
+      error( RtAudioError::WARNING );
+    }
+    frames = 0;
+  }
+  else if ( result < 0 ) {
+    errorStream_ << "RtApiAlsa::pollCapture: audio read error, " << snd_strerror( result ) << ".";
+    errorText_ = errorStream_.str();
+    error( RtAudioError::WARNING );
+    frames = 0;
+  }
+
+  MUTEX_UNLOCK( &stream_.mutex );
+
+  // A timeout or an overrun delivers nothing.
+  if ( frames <= 0 ) return;
+
+  RtAudioStreamStatus status = 0;
+  if ( apiInfo->xrun[1] == true ) {
+    status |= RTAUDIO_INPUT_OVERFLOW;
+    apiInfo->xrun[1] = false;
+  }
+
+  RtAudioCallback callback = (RtAudioCallback) stream_.callbackInfo.callback;
+  int doStopStream = callback( NULL, stream_.userBuffer[1], frames, getStreamTime(), status, stream_.callbackInfo.userData );
+
+  // Stream time advances by the chunk actually delivered.
+  stream_.streamTime += ( frames * 1.0 / stream_.sampleRate );
+#if defined( HAVE_GETTIMEOFDAY )
+  gettimeofday( &stream_.lastTickTimestamp, NULL );
+#endif
+
+  if ( doStopStream == 2 ) abortStream();
+  else if ( doStopStream == 1 ) this->stopStream();
+}
+
 static void *alsaCallbackHandler( void *ptr )
 {
   CallbackInfo *info = (CallbackInfo *) ptr;
@@ -8422,8 +8783,7 @@ static void *alsaCallbackHandler( void *ptr )
 // Code written by Peter Meerwald, pmeerw@pmeerw.net
 // and Tristan Matthews.
 
-#include <pulse/error.h>
-#include <pulse/simple.h>
+#include <pulse/pulseaudio.h>
 #include <cstdio>
 
 static const unsigned int SUPPORTED_SAMPLERATES[] = { 8000, 16000, 22050, 32000,
@@ -8441,43 +8801,231 @@ static const rtaudio_pa_format_mapping_t supported_sampleformats[] = {
   {0, PA_SAMPLE_INVALID}};
 
 struct PulseAudioHandle {
-  pa_simple *s_play;
-  pa_simple *s_rec;
+  pa_threaded_mainloop *mainloop;
+  pa_context *context;
+  pa_stream *s_play;
+  pa_stream *s_rec;
+  size_t recOffset; // bytes of the peeked capture fragment already used
+  bool xrun[2];
   pthread_t thread;
   pthread_cond_t runnable_cv;
   bool runnable;
-  PulseAudioHandle() : s_play(0), s_rec(0), runnable(false) { }
+  PulseAudioHandle() : mainloop(0), context(0), s_play(0), s_rec(0), recOffset(0), runnable(false) { xrun[0] = false; xrun[1] = false; }
 };
 
-RtApiPulse::~RtApiPulse()
+// Stream and context notifications arrive on the mainloop thread, they
+// only record the event and wake whoever waits on the mainloop.
+static void rtaudio_pa_context_notify( pa_context * /*c*/, void *userdata )
 {
-  if ( stream_.state != STREAM_CLOSED )
-    closeStream();
+  pa_threaded_mainloop_signal( static_cast<PulseAudioHandle *>( userdata )->mainloop, 0 );
 }
 
-unsigned int RtApiPulse::getDeviceCount( void )
+static void rtaudio_pa_stream_notify( pa_stream * /*s*/, void *userdata )
 {
-  return 1;
+  pa_threaded_mainloop_signal( static_cast<PulseAudioHandle *>( userdata )->mainloop, 0 );
 }
 
-RtAudio::DeviceInfo RtApiPulse::getDeviceInfo( unsigned int /*device*/ )
+static void rtaudio_pa_stream_request( pa_stream * /*s*/, size_t /*nbytes*/, void *userdata )
 {
-  RtAudio::DeviceInfo info;
-  info.probed = true;
-  info.name = "PulseAudio";
-  info.outputChannels = 2;
-  info.inputChannels = 2;
-  info.duplexChannels = 2;
-  info.isDefaultOutput = true;
-  info.isDefaultInput = true;
+  pa_threaded_mainloop_signal( static_cast<PulseAudioHandle *>( userdata )->mainloop, 0 );
+}
+
+static void rtaudio_pa_stream_success( pa_stream * /*s*/, int /*success*/, void *userdata )
+{
+  pa_threaded_mainloop_signal( static_cast<PulseAudioHandle *>( userdata )->mainloop, 0 );
+}
+
+static void rtaudio_pa_underflow( pa_stream * /*s*/, void *userdata )
+{
+  static_cast<PulseAudioHandle *>( userdata )->xrun[0] = true;
+}
+
+static void rtaudio_pa_overflow( pa_stream * /*s*/, void *userdata )
+{
+  static_cast<PulseAudioHandle *>( userdata )->xrun[1] = true;
+}
+
+// Waits for an operation to complete, called with the mainloop locked.
+static void rtaudio_pa_wait( PulseAudioHandle *pah, pa_operation *op )
+{
+  if ( !op ) return;
+  while ( pa_operation_get_state( op ) == PA_OPERATION_RUNNING )
+    pa_threaded_mainloop_wait( pah->mainloop );
+  pa_operation_unref( op );
+}
+
+// Disconnects the streams and the context and stops the mainloop.
+static void rtaudio_pa_release( PulseAudioHandle *pah )
+{
+  if ( !pah->mainloop ) return;
+
+  pa_threaded_mainloop_lock( pah->mainloop );
+  pa_stream *streams[2] = { pah->s_play, pah->s_rec };
+  for ( int i=0; i<2; i++ ) {
+    if ( !streams[i] ) continue;
+    pa_stream_disconnect( streams[i] );
+    pa_stream_unref( streams[i] );
+  }
+  pah->s_play = 0;
+  pah->s_rec = 0;
+  if ( pah->context ) {
+    pa_context_disconnect( pah->context );
+    pa_context_unref( pah->context );
+    pah->context = 0;
+  }
+  pa_threaded_mainloop_unlock( pah->mainloop );
+
+  pa_threaded_mainloop_stop( pah->mainloop );
+  pa_threaded_mainloop_free( pah->mainloop );
+  pah->mainloop = 0;
+}
+
+// Sources and sinks as reported by the server during enumeration.
+struct PulseDeviceList {
+  std::vector<RtAudio::DeviceInfo> devices;
+  std::vector<std::string> ids;
+  std::string defaultSource;
+  std::string defaultSink;
+  int pending;
+};
 
+static void rtaudio_pa_fill_info( RtAudio::DeviceInfo &info, const char *description, const char *name,
+                                  const pa_sample_spec &ss )
+{
+  // The server resamples, so the standard rates are offered next to the native one.
+  info.probed = true;
+  info.name = description ? description : name;
   for ( const unsigned int *sr = SUPPORTED_SAMPLERATES; *sr; ++sr )
     info.sampleRates.push_back( *sr );
-
-  info.preferredSampleRate = 48000;
+  if ( std::find( info.sampleRates.begin(), info.sampleRates.end(), ss.rate ) == info.sampleRates.end() ) {
+    info.sampleRates.push_back( ss.rate );
+    std::sort( info.sampleRates.begin(), info.sampleRates.end() );
+  }
+  info.preferredSampleRate = ss.rate;
   info.nativeFormats = RTAUDIO_SINT16 | RTAUDIO_SINT32 | RTAUDIO_FLOAT32;
+}
 
-  return info;
+static void rtaudio_pa_server_info( pa_context * /*c*/, const pa_server_info *i, void *userdata )
+{
+  PulseDeviceList *list = static_cast<PulseDeviceList *>( userdata );
+  if ( i && i->default_source_name ) list->defaultSource = i->default_source_name;
+  if ( i && i->default_sink_name ) list->defaultSink = i->default_sink_name;
+  list->pending--;
+}
+
+static void rtaudio_pa_source_info( pa_context * /*c*/, const pa_source_info *i, int eol, void *userdata )
+{
+  PulseDeviceList *list = static_cast<PulseDeviceList *>( userdata );
+  if ( eol ) {
+    list->pending--;
+    return;
+  }
+
+  // Monitors of the sinks are listed too, they capture what is played.
+  RtAudio::DeviceInfo info;
+  rtaudio_pa_fill_info( info, i->description, i->name, i->sample_spec );
+  info.inputChannels = i->sample_spec.channels;
+  list->devices.push_back( info );
+  list->ids.push_back( i->name );
+}
+
+static void rtaudio_pa_sink_info( pa_context * /*c*/, const pa_sink_info *i, int eol, void *userdata )
+{
+  PulseDeviceList *list = static_cast<PulseDeviceList *>( userdata );
+  if ( eol ) {
+    list->pending--;
+    return;
+  }
+
+  RtAudio::DeviceInfo info;
+  rtaudio_pa_fill_info( info, i->description, i->name, i->sample_spec );
+  info.outputChannels = i->sample_spec.channels;
+  list->devices.push_back( info );
+  list->ids.push_back( i->name );
+}
+
+static void rtaudio_pa_introspect( pa_operation *op, PulseDeviceList &list )
+{
+  if ( op ) pa_operation_unref( op );
+  else list.pending--;
+}
+
+RtApiPulse::~RtApiPulse()
+{
+  if ( stream_.state != STREAM_CLOSED )
+    closeStream();
+}
+
+void RtApiPulse::saveDeviceInfo( void )
+{
+  // Device 0 follows the server defaults in both directions, the sources
+  // and sinks come after it.  Without a server only device 0 is listed.
+  RtAudio::DeviceInfo defaultInfo;
+  pa_sample_spec defaultSpec;
+  defaultSpec.format = PA_SAMPLE_FLOAT32LE;
+  defaultSpec.rate = 48000;
+  defaultSpec.channels = 2;
+  rtaudio_pa_fill_info( defaultInfo, "PulseAudio", NULL, defaultSpec );
+  defaultInfo.outputChannels = 2;
+  defaultInfo.inputChannels = 2;
+  defaultInfo.duplexChannels = 2;
+  defaultInfo.isDefaultOutput = true;
+  defaultInfo.isDefaultInput = true;
+
+  devices_.assign( 1, defaultInfo );
+  deviceIds_.assign( 1, std::string() );
+
+  PulseDeviceList list;
+  list.pending = 0;
+  bool queried = false;
+
+  pa_mainloop *mainloop = pa_mainloop_new();
+  if ( !mainloop ) return;
+  pa_context *context = pa_context_new( pa_mainloop_get_api( mainloop ), "RtAudio" );
+  if ( context && pa_context_connect( context, NULL, PA_CONTEXT_NOFLAGS, NULL ) >= 0 ) {
+    while ( true ) {
+      pa_context_state_t state = pa_context_get_state( context );
+      if ( !PA_CONTEXT_IS_GOOD( state ) ) break;
+      if ( state == PA_CONTEXT_READY && !queried ) {
+        list.pending = 3;
+        rtaudio_pa_introspect( pa_context_get_server_info( context, rtaudio_pa_server_info, &list ), list );
+        rtaudio_pa_introspect( pa_context_get_source_info_list( context, rtaudio_pa_source_info, &list ), list );
+        rtaudio_pa_introspect( pa_context_get_sink_info_list( context, rtaudio_pa_sink_info, &list ), list );
+        queried = true;
+      }
+      if ( queried && list.pending <= 0 ) break;
+      if ( pa_mainloop_iterate( mainloop, 1, NULL ) < 0 ) break;
+    }
+    pa_context_disconnect( context );
+  }
+  if ( context ) pa_context_unref( context );
+  pa_mainloop_free( mainloop );
+
+  if ( !queried || list.pending > 0 ) return;
+  for ( unsigned int i=0; i<list.devices.size(); i++ ) {
+    list.devices[i].isDefaultInput = list.devices[i].inputChannels > 0 && list.ids[i] == list.defaultSource;
+    list.devices[i].isDefaultOutput = list.devices[i].outputChannels > 0 && list.ids[i] == list.defaultSink;
+  }
+  devices_.insert( devices_.end(), list.devices.begin(), list.devices.end() );
+  deviceIds_.insert( deviceIds_.end(), list.ids.begin(), list.ids.end() );
+}
+
+unsigned int RtApiPulse::getDeviceCount( void )
+{
+  saveDeviceInfo();
+  return devices_.size();
+}
+
+RtAudio::DeviceInfo RtApiPulse::getDeviceInfo( unsigned int device )
+{
+  if ( device >= devices_.size() ) saveDeviceInfo();
+  if ( device >= devices_.size() ) {
+    errorText_ = "RtApiPulse::getDeviceInfo: device ID is invalid!";
+    error( RtAudioError::INVALID_USE );
+    return RtAudio::DeviceInfo();
+  }
+
+  return devices_[device];
 }
 
 static void *pulseaudio_callback( void * user )
@@ -8516,12 +9064,7 @@ void RtApiPulse::closeStream( void )
     MUTEX_UNLOCK( &stream_.mutex );
 
     pthread_join( pah->thread, 0 );
-    if ( pah->s_play ) {
-      pa_simple_flush( pah->s_play, NULL );
-      pa_simple_free( pah->s_play );
-    }
-    if ( pah->s_rec )
-      pa_simple_free( pah->s_rec );
+    rtaudio_pa_release( pah );
 
     pthread_cond_destroy( &pah->runnable_cv );
     delete pah;
@@ -8567,6 +9110,14 @@ void RtApiPulse::callbackEvent( void )
   RtAudioCallback callback = (RtAudioCallback) stream_.callbackInfo.callback;
   double streamTime = getStreamTime();
   RtAudioStreamStatus status = 0;
+  if ( stream_.mode != INPUT && pah->xrun[0] == true ) {
+    status |= RTAUDIO_OUTPUT_UNDERFLOW;
+    pah->xrun[0] = false;
+  }
+  if ( stream_.mode != OUTPUT && pah->xrun[1] == true ) {
+    status |= RTAUDIO_INPUT_OVERFLOW;
+    pah->xrun[1] = false;
+  }
   int doStopStream = callback( stream_.userBuffer[OUTPUT], stream_.userBuffer[INPUT],
                                stream_.bufferSize, streamTime, status,
                                stream_.callbackInfo.userData );
@@ -8577,55 +9128,98 @@ void RtApiPulse::callbackEvent( void )
   }
 
   MUTEX_LOCK( &stream_.mutex );
-  void *pulse_in = stream_.doConvertBuffer[INPUT] ? stream_.deviceBuffer : stream_.userBuffer[INPUT];
-  void *pulse_out = stream_.doConvertBuffer[OUTPUT] ? stream_.deviceBuffer : stream_.userBuffer[OUTPUT];
+  pa_threaded_mainloop_lock( pah->mainloop );
 
   if ( stream_.state != STREAM_RUNNING )
     goto unlock;
 
-  int pa_error;
-  size_t bytes;
-  if (stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
+  if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
+    const char *pulse_out;
+    size_t bytes;
     if ( stream_.doConvertBuffer[OUTPUT] ) {
-        convertBuffer( stream_.deviceBuffer,
-                       stream_.userBuffer[OUTPUT],
-                       stream_.convertInfo[OUTPUT] );
-        bytes = stream_.nDeviceChannels[OUTPUT] * stream_.bufferSize *
-                formatBytes( stream_.deviceFormat[OUTPUT] );
-    } else
-        bytes = stream_.nUserChannels[OUTPUT] * stream_.bufferSize *
-                formatBytes( stream_.userFormat );
-
-    if ( pa_simple_write( pah->s_play, pulse_out, bytes, &pa_error ) < 0 ) {
-      errorStream_ << "RtApiPulse::callbackEvent: audio write error, " <<
-        pa_strerror( pa_error ) << ".";
-      errorText_ = errorStream_.str();
-      error( RtAudioError::WARNING );
+      convertBuffer( stream_.deviceBuffer,
+                     stream_.userBuffer[OUTPUT],
+                     stream_.convertInfo[OUTPUT] );
+      pulse_out = stream_.deviceBuffer;
+      bytes = stream_.nDeviceChannels[OUTPUT] * stream_.bufferSize *
+              formatBytes( stream_.deviceFormat[OUTPUT] );
+    }
+    else {
+      pulse_out = stream_.userBuffer[OUTPUT];
+      bytes = stream_.nUserChannels[OUTPUT] * stream_.bufferSize *
+              formatBytes( stream_.userFormat );
+    }
+
+    // Blocks until the server has room for the whole buffer.
+    while ( bytes > 0 && stream_.state == STREAM_RUNNING ) {
+      size_t writable = pa_stream_writable_size( pah->s_play );
+      if ( writable == (size_t) -1 ||
+           ( writable > 0 && pa_stream_write( pah->s_play, pulse_out, std::min( writable, bytes ), NULL, 0, PA_SEEK_RELATIVE ) < 0 ) ) {
+        errorStream_ << "RtApiPulse::callbackEvent: audio write error, " <<
+          pa_strerror( pa_context_errno( pah->context ) ) << ".";
+        errorText_ = errorStream_.str();
+        error( RtAudioError::WARNING );
+        break;
+      }
+      if ( writable == 0 ) {
+        pa_threaded_mainloop_wait( pah->mainloop );
+        continue;
+      }
+      pulse_out += std::min( writable, bytes );
+      bytes -= std::min( writable, bytes );
     }
   }
 
-  if ( stream_.mode == INPUT || stream_.mode == DUPLEX) {
-    if ( stream_.doConvertBuffer[INPUT] )
-      bytes = stream_.nDeviceChannels[INPUT] * stream_.bufferSize *
-        formatBytes( stream_.deviceFormat[INPUT] );
-    else
-      bytes = stream_.nUserChannels[INPUT] * stream_.bufferSize *
-        formatBytes( stream_.userFormat );
-            
-    if ( pa_simple_read( pah->s_rec, pulse_in, bytes, &pa_error ) < 0 ) {
-      errorStream_ << "RtApiPulse::callbackEvent: audio read error, " <<
-        pa_strerror( pa_error ) << ".";
-      errorText_ = errorStream_.str();
-      error( RtAudioError::WARNING );
-    }
-    if ( stream_.doConvertBuffer[INPUT] ) {
-      convertBuffer( stream_.userBuffer[INPUT],
-                     stream_.deviceBuffer,
-                     stream_.convertInfo[INPUT] );
+  if ( stream_.mode == INPUT || stream_.mode == DUPLEX ) {
+    // Fragments are converted or copied straight out of the server's
+    // memblocks, a fragment that is not used up is kept for the next buffer.
+    const size_t frameBytes = stream_.nDeviceChannels[INPUT] * formatBytes( stream_.deviceFormat[INPUT] );
+    const size_t userFrameBytes = formatBytes( stream_.userFormat ) *
+      ( stream_.userInterleaved ? stream_.nUserChannels[INPUT] : 1 );
+    unsigned int done = 0;
+
+    while ( done < stream_.bufferSize && stream_.state == STREAM_RUNNING ) {
+      const void *data = 0;
+      size_t nbytes = 0;
+      if ( pa_stream_peek( pah->s_rec, &data, &nbytes ) < 0 ) {
+        errorStream_ << "RtApiPulse::callbackEvent: audio read error, " <<
+          pa_strerror( pa_context_errno( pah->context ) ) << ".";
+        errorText_ = errorStream_.str();
+        error( RtAudioError::WARNING );
+        break;
+      }
+      if ( nbytes == 0 ) {
+        pa_threaded_mainloop_wait( pah->mainloop );
+        continue;
+      }
+
+      // A hole carries no samples, it is skipped.
+      if ( data ) {
+        unsigned int frames = std::min<size_t>( ( nbytes - pah->recOffset ) / frameBytes, stream_.bufferSize - done );
+        char *fragment = (char *) data + pah->recOffset;
+        if ( stream_.doConvertBuffer[INPUT] )
+          convertBuffer( stream_.userBuffer[INPUT] + done * userFrameBytes, fragment, stream_.convertInfo[INPUT], frames );
+        else
+          memcpy( stream_.userBuffer[INPUT] + done * frameBytes, fragment, frames * frameBytes );
+        done += frames;
+        pah->recOffset += frames * frameBytes;
+      }
+
+      if ( !data || pah->recOffset + frameBytes > nbytes ) {
+        pa_stream_drop( pah->s_rec );
+        pah->recOffset = 0;
+      }
     }
+
+    // Check stream latency
+    pa_usec_t usec;
+    int negative;
+    if ( pa_stream_get_latency( pah->s_rec, &usec, &negative ) == 0 && !negative )
+      stream_.latency[INPUT] = usec * stream_.sampleRate / 1000000;
   }
 
  unlock:
+  pa_threaded_mainloop_unlock( pah->mainloop );
   MUTEX_UNLOCK( &stream_.mutex );
   RtApi::tickStreamTime();
 
@@ -8650,6 +9244,18 @@ void RtApiPulse::startStream( void )
 
   MUTEX_LOCK( &stream_.mutex );
 
+  // Capture starts from fresh data, whatever was left over is dropped.
+  pa_threaded_mainloop_lock( pah->mainloop );
+  if ( pah->s_rec ) {
+    if ( pah->recOffset > 0 ) pa_stream_drop( pah->s_rec );
+    pah->recOffset = 0;
+    rtaudio_pa_wait( pah, pa_stream_flush( pah->s_rec, rtaudio_pa_stream_success, pah ) );
+    rtaudio_pa_wait( pah, pa_stream_cork( pah->s_rec, 0, rtaudio_pa_stream_success, pah ) );
+  }
+  if ( pah->s_play )
+    rtaudio_pa_wait( pah, pa_stream_cork( pah->s_play, 0, rtaudio_pa_stream_success, pah ) );
+  pa_threaded_mainloop_unlock( pah->mainloop );
+
   #if defined( HAVE_GETTIMEOFDAY )
   gettimeofday( &stream_.lastTickTimestamp, NULL );
   #endif
@@ -8676,20 +9282,22 @@ void RtApiPulse::stopStream( void )
     return;
   }
 
+  // Wake the callback thread if it waits on the server.
   stream_.state = STREAM_STOPPED;
+  pa_threaded_mainloop_lock( pah->mainloop );
+  pa_threaded_mainloop_signal( pah->mainloop, 0 );
+  pa_threaded_mainloop_unlock( pah->mainloop );
+
   MUTEX_LOCK( &stream_.mutex );
 
-  if ( pah && pah->s_play ) {
-    int pa_error;
-    if ( pa_simple_drain( pah->s_play, &pa_error ) < 0 ) {
-      errorStream_ << "RtApiPulse::stopStream: error draining output device, " <<
-        pa_strerror( pa_error ) << ".";
-      errorText_ = errorStream_.str();
-      MUTEX_UNLOCK( &stream_.mutex );
-      error( RtAudioError::SYSTEM_ERROR );
-      return;
-    }
+  pa_threaded_mainloop_lock( pah->mainloop );
+  if ( pah->s_play ) {
+    rtaudio_pa_wait( pah, pa_stream_drain( pah->s_play, rtaudio_pa_stream_success, pah ) );
+    rtaudio_pa_wait( pah, pa_stream_cork( pah->s_play, 1, rtaudio_pa_stream_success, pah ) );
   }
+  if ( pah->s_rec )
+    rtaudio_pa_wait( pah, pa_stream_cork( pah->s_rec, 1, rtaudio_pa_stream_success, pah ) );
+  pa_threaded_mainloop_unlock( pah->mainloop );
 
   stream_.state = STREAM_STOPPED;
   MUTEX_UNLOCK( &stream_.mutex );
@@ -8710,20 +9318,22 @@ void RtApiPulse::abortStream( void )
     return;
   }
 
+  // Wake the callback thread if it waits on the server.
   stream_.state = STREAM_STOPPED;
+  pa_threaded_mainloop_lock( pah->mainloop );
+  pa_threaded_mainloop_signal( pah->mainloop, 0 );
+  pa_threaded_mainloop_unlock( pah->mainloop );
+
   MUTEX_LOCK( &stream_.mutex );
 
-  if ( pah && pah->s_play ) {
-    int pa_error;
-    if ( pa_simple_flush( pah->s_play, &pa_error ) < 0 ) {
-      errorStream_ << "RtApiPulse::abortStream: error flushing output device, " <<
-        pa_strerror( pa_error ) << ".";
-      errorText_ = errorStream_.str();
-      MUTEX_UNLOCK( &stream_.mutex );
-      error( RtAudioError::SYSTEM_ERROR );
-      return;
-    }
+  pa_threaded_mainloop_lock( pah->mainloop );
+  if ( pah->s_play ) {
+    rtaudio_pa_wait( pah, pa_stream_flush( pah->s_play, rtaudio_pa_stream_success, pah ) );
+    rtaudio_pa_wait( pah, pa_stream_cork( pah->s_play, 1, rtaudio_pa_stream_success, pah ) );
   }
+  if ( pah->s_rec )
+    rtaudio_pa_wait( pah, pa_stream_cork( pah->s_rec, 1, rtaudio_pa_stream_success, pah ) );
+  pa_threaded_mainloop_unlock( pah->mainloop );
 
   stream_.state = STREAM_STOPPED;
   MUTEX_UNLOCK( &stream_.mutex );
@@ -8737,30 +9347,40 @@ bool RtApiPulse::probeDeviceOpen( unsigned int device, StreamMode mode,
   PulseAudioHandle *pah = 0;
   unsigned long bufferBytes = 0;
   pa_sample_spec ss;
+  pa_buffer_attr buffer_attr;
+  const pa_buffer_attr *actual = 0;
+  pa_stream *stream = 0;
+  pa_stream_state_t streamState = PA_STREAM_UNCONNECTED;
+  int flags = PA_STREAM_START_CORKED | PA_STREAM_ADJUST_LATENCY |
+    PA_STREAM_AUTO_TIMING_UPDATE | PA_STREAM_INTERPOLATE_TIMING;
+  unsigned int periods = 0;
+  std::string deviceId;
 
-  if ( device != 0 ) return false;
   if ( mode != INPUT && mode != OUTPUT ) return false;
-  if ( channels != 1 && channels != 2 ) {
-    errorText_ = "RtApiPulse::probeDeviceOpen: unsupported number of channels.";
+
+  if ( device >= devices_.size() ) saveDeviceInfo();
+  if ( device >= devices_.size() ) {
+    errorText_ = "RtApiPulse::probeDeviceOpen: device ID is invalid!";
     return false;
   }
-  ss.channels = channels;
-
-  if ( firstChannel != 0 ) return false;
+  deviceId = deviceIds_[device];
 
-  bool sr_found = false;
-  for ( const unsigned int *sr = SUPPORTED_SAMPLERATES; *sr; ++sr ) {
-    if ( sampleRate == *sr ) {
-      sr_found = true;
-      stream_.sampleRate = sampleRate;
-      ss.rate = sampleRate;
-      break;
-    }
+  // Channels before the first one are captured or played as well and
+  // skipped by the buffer conversion.
+  unsigned int deviceChannels = ( mode == INPUT ) ? devices_[device].inputChannels : devices_[device].outputChannels;
+  if ( channels == 0 || channels + firstChannel > deviceChannels || channels + firstChannel > PA_CHANNELS_MAX ) {
+    errorText_ = "RtApiPulse::probeDeviceOpen: unsupported number of channels.";
+    return false;
   }
-  if ( !sr_found ) {
+  ss.channels = channels + firstChannel;
+
+  // The server resamples to the device rate.
+  if ( sampleRate == 0 || sampleRate > PA_RATE_MAX ) {
     errorText_ = "RtApiPulse::probeDeviceOpen: unsupported sample rate.";
     return false;
   }
+  stream_.sampleRate = sampleRate;
+  ss.rate = sampleRate;
 
   bool sf_found = 0;
   for ( const rtaudio_pa_format_mapping_t *sf = supported_sampleformats;
@@ -8783,7 +9403,6 @@ bool RtApiPulse::probeDeviceOpen( unsigned int device, StreamMode mode,
   if ( options && options->flags & RTAUDIO_NONINTERLEAVED ) stream_.userInterleaved = false;
   else stream_.userInterleaved = true;
   stream_.deviceInterleaved[mode] = true;
-  stream_.nBuffers = 1;
   stream_.doByteSwap[mode] = false;
   stream_.nUserChannels[mode] = channels;
   stream_.nDeviceChannels[mode] = channels + firstChannel;
@@ -8796,6 +9415,9 @@ bool RtApiPulse::probeDeviceOpen( unsigned int device, StreamMode mode,
     stream_.doConvertBuffer[mode] = true;
   if ( stream_.nUserChannels[mode] < stream_.nDeviceChannels[mode] )
     stream_.doConvertBuffer[mode] = true;
+  if ( stream_.userInterleaved != stream_.deviceInterleaved[mode] &&
+       stream_.nUserChannels[mode] > 1 )
+    stream_.doConvertBuffer[mode] = true;
 
   // Allocate necessary internal buffers.
   bufferBytes = stream_.nUserChannels[mode] * *bufferSize * formatBytes( stream_.userFormat );
@@ -8806,25 +9428,15 @@ bool RtApiPulse::probeDeviceOpen( unsigned int device, StreamMode mode,
   }
   stream_.bufferSize = *bufferSize;
 
-  if ( stream_.doConvertBuffer[mode] ) {
-
-    bool makeBuffer = true;
-    bufferBytes = stream_.nDeviceChannels[mode] * formatBytes( stream_.deviceFormat[mode] );
-    if ( mode == INPUT ) {
-      if ( stream_.mode == OUTPUT && stream_.deviceBuffer ) {
-        unsigned long bytesOut = stream_.nDeviceChannels[0] * formatBytes( stream_.deviceFormat[0] );
-        if ( bufferBytes <= bytesOut ) makeBuffer = false;
-      }
-    }
-
-    if ( makeBuffer ) {
-      bufferBytes *= *bufferSize;
-      if ( stream_.deviceBuffer ) free( stream_.deviceBuffer );
-      stream_.deviceBuffer = (char *) calloc( bufferBytes, 1 );
-      if ( stream_.deviceBuffer == NULL ) {
-        errorText_ = "RtApiPulse::probeDeviceOpen: error allocating device buffer memory.";
-        goto error;
-      }
+  // Capture converts out of the server's fragments, only playback needs
+  // a device buffer.
+  if ( stream_.doConvertBuffer[mode] && mode == OUTPUT ) {
+    bufferBytes = stream_.nDeviceChannels[mode] * formatBytes( stream_.deviceFormat[mode] ) * *bufferSize;
+    if ( stream_.deviceBuffer ) free( stream_.deviceBuffer );
+    stream_.deviceBuffer = (char *) calloc( bufferBytes, 1 );
+    if ( stream_.deviceBuffer == NULL ) {
+      errorText_ = "RtApiPulse::probeDeviceOpen: error allocating device buffer memory.";
+      goto error;
     }
   }
 
@@ -8833,46 +9445,104 @@ bool RtApiPulse::probeDeviceOpen( unsigned int device, StreamMode mode,
   // Setup the buffer conversion information structure.
   if ( stream_.doConvertBuffer[mode] ) setConvertInfo( mode, firstChannel );
 
-  if ( !stream_.apiHandle ) {
-    PulseAudioHandle *pah = new PulseAudioHandle;
-    if ( !pah ) {
-      errorText_ = "RtApiPulse::probeDeviceOpen: error allocating memory for handle.";
-      goto error;
-    }
+  if ( options && !options->streamName.empty() ) streamName = options->streamName;
 
+  if ( !stream_.apiHandle ) {
+    pah = new PulseAudioHandle;
     stream_.apiHandle = pah;
     if ( pthread_cond_init( &pah->runnable_cv, NULL ) != 0 ) {
       errorText_ = "RtApiPulse::probeDeviceOpen: error creating condition variable.";
       goto error;
     }
-  }
-  pah = static_cast<PulseAudioHandle *>( stream_.apiHandle );
 
-  int error;
-  if ( options && !options->streamName.empty() ) streamName = options->streamName;
-  switch ( mode ) {
-  case INPUT:
-    pa_buffer_attr buffer_attr;
-    buffer_attr.fragsize = bufferBytes;
-    buffer_attr.maxlength = -1;
-
-    pah->s_rec = pa_simple_new( NULL, streamName.c_str(), PA_STREAM_RECORD, NULL, "Record", &ss, NULL, &buffer_attr, &error );
-    if ( !pah->s_rec ) {
-      errorText_ = "RtApiPulse::probeDeviceOpen: error connecting input to PulseAudio server.";
+    // One context per stream, served by its own mainloop thread.
+    pah->mainloop = pa_threaded_mainloop_new();
+    if ( pah->mainloop )
+      pah->context = pa_context_new( pa_threaded_mainloop_get_api( pah->mainloop ), streamName.c_str() );
+    if ( !pah->context ) {
+      errorText_ = "RtApiPulse::probeDeviceOpen: error creating PulseAudio context.";
       goto error;
     }
-    break;
-  case OUTPUT:
-    pah->s_play = pa_simple_new( NULL, streamName.c_str(), PA_STREAM_PLAYBACK, NULL, "Playback", &ss, NULL, NULL, &error );
-    if ( !pah->s_play ) {
-      errorText_ = "RtApiPulse::probeDeviceOpen: error connecting output to PulseAudio server.";
+    pa_context_set_state_callback( pah->context, rtaudio_pa_context_notify, pah );
+    if ( pa_context_connect( pah->context, NULL, PA_CONTEXT_NOFLAGS, NULL ) < 0 ||
+         pa_threaded_mainloop_start( pah->mainloop ) < 0 ) {
+      errorText_ = "RtApiPulse::probeDeviceOpen: error connecting to PulseAudio server.";
       goto error;
     }
-    break;
-  default:
+
+    pa_threaded_mainloop_lock( pah->mainloop );
+    pa_context_state_t contextState;
+    while ( ( contextState = pa_context_get_state( pah->context ) ) != PA_CONTEXT_READY &&
+            PA_CONTEXT_IS_GOOD( contextState ) )
+      pa_threaded_mainloop_wait( pah->mainloop );
+    pa_threaded_mainloop_unlock( pah->mainloop );
+    if ( contextState != PA_CONTEXT_READY ) {
+      errorText_ = "RtApiPulse::probeDeviceOpen: error connecting to PulseAudio server.";
+      goto error;
+    }
+  }
+  pah = static_cast<PulseAudioHandle *>( stream_.apiHandle );
+
+  // The server keeps at most the given number of buffers, with adjusted
+  // latency a capture fragment arrives as soon as one buffer is ready.
+  if ( options && options->flags & RTAUDIO_MINIMIZE_LATENCY ) periods = 2;
+  if ( options && options->numberOfBuffers > 0 ) periods = options->numberOfBuffers;
+  if ( periods < 2 ) periods = 4;
+  bufferBytes = stream_.nDeviceChannels[mode] * formatBytes( stream_.deviceFormat[mode] ) * *bufferSize;
+  buffer_attr.maxlength = (uint32_t) -1;
+  buffer_attr.tlength = (uint32_t) -1;
+  buffer_attr.prebuf = (uint32_t) -1;
+  buffer_attr.minreq = (uint32_t) -1;
+  buffer_attr.fragsize = (uint32_t) -1;
+
+  pa_threaded_mainloop_lock( pah->mainloop );
+  stream = pa_stream_new( pah->context, ( mode == INPUT ) ? "Record" : "Playback", &ss, NULL );
+  if ( stream ) {
+    pa_stream_set_state_callback( stream, rtaudio_pa_stream_notify, pah );
+    if ( mode == INPUT ) {
+      buffer_attr.maxlength = bufferBytes * periods;
+      buffer_attr.fragsize = bufferBytes;
+      pa_stream_set_read_callback( stream, rtaudio_pa_stream_request, pah );
+      pa_stream_set_overflow_callback( stream, rtaudio_pa_overflow, pah );
+      pa_stream_connect_record( stream, deviceId.empty() ? NULL : deviceId.c_str(), &buffer_attr,
+                                (pa_stream_flags_t) flags );
+    }
+    else {
+      buffer_attr.tlength = bufferBytes * periods;
+      buffer_attr.minreq = bufferBytes;
+      pa_stream_set_write_callback( stream, rtaudio_pa_stream_request, pah );
+      pa_stream_set_underflow_callback( stream, rtaudio_pa_underflow, pah );
+      pa_stream_connect_playback( stream, deviceId.empty() ? NULL : deviceId.c_str(), &buffer_attr,
+                                  (pa_stream_flags_t) flags, NULL, NULL );
+    }
+    while ( ( streamState = pa_stream_get_state( stream ) ) != PA_STREAM_READY &&
+            PA_STREAM_IS_GOOD( streamState ) )
+      pa_threaded_mainloop_wait( pah->mainloop );
+  }
+  if ( streamState != PA_STREAM_READY ) {
+    errorStream_ << "RtApiPulse::probeDeviceOpen: error connecting " << ( ( mode == INPUT ) ? "input" : "output" )
+                 << " to PulseAudio server, " << pa_strerror( pa_context_errno( pah->context ) ) << ".";
+    errorText_ = errorStream_.str();
+    if ( stream ) {
+      pa_stream_disconnect( stream );
+      pa_stream_unref( stream );
+    }
+    pa_threaded_mainloop_unlock( pah->mainloop );
     goto error;
   }
 
+  // Report the buffering the server settled on.
+  actual = pa_stream_get_buffer_attr( stream );
+  if ( actual && mode == INPUT && actual->fragsize > 0 )
+    periods = std::max<uint32_t>( actual->maxlength / actual->fragsize, 1 );
+  else if ( actual && mode == OUTPUT && actual->minreq > 0 )
+    periods = std::max<uint32_t>( actual->tlength / actual->minreq, 1 );
+  stream_.nBuffers = periods;
+
+  if ( mode == INPUT ) pah->s_rec = stream;
+  else pah->s_play = stream;
+  pa_threaded_mainloop_unlock( pah->mainloop );
+
   if ( stream_.mode == UNINITIALIZED )
     stream_.mode = mode;
   else if ( stream_.mode == mode )
@@ -8934,7 +9604,9 @@ bool RtApiPulse::probeDeviceOpen( unsigned int device, StreamMode mode,
   return SUCCESS;
  
  error:
-  if ( pah && stream_.callbackInfo.isRunning ) {
+  // A handle without a callback thread belongs to this failed open only.
+  if ( pah && !stream_.callbackInfo.isRunning ) {
+    rtaudio_pa_release( pah );
     pthread_cond_destroy( &pah->runnable_cv );
     delete pah;
     stream_.apiHandle = 0;
@@ -8959,6 +9631,530 @@ bool RtApiPulse::probeDeviceOpen( unsigned int device, StreamMode mode,
 //******************** End of __LINUX_PULSE__ *********************//
 #endif
 
+#if defined(__LINUX_PIPEWIRE__)
+
+// Capture on the native PipeWire stream API.  Buffers are mapped into
+// the process and the process callback runs on PipeWire's realtime data
+// thread, which calls the user callback directly, like the Jack backend.
+
+#include <pipewire/pipewire.h>
+#include <spa/param/audio/format-utils.h>
+#include <cstdio>
+
+static const unsigned int PIPEWIRE_SAMPLERATES[] = { 8000, 16000, 22050, 32000,
+                                                     44100, 48000, 96000, 192000, 0 };
+
+struct rtaudio_pw_format_mapping_t {
+  RtAudioFormat rtaudio_format;
+  enum spa_audio_format pw_format;
+};
+
+static const rtaudio_pw_format_mapping_t pipewire_sampleformats[] = {
+  {RTAUDIO_SINT16, SPA_AUDIO_FORMAT_S16},
+  {RTAUDIO_SINT32, SPA_AUDIO_FORMAT_S32},
+  {RTAUDIO_FLOAT32, SPA_AUDIO_FORMAT_F32},
+  {0, SPA_AUDIO_FORMAT_UNKNOWN}};
+
+struct PipeWireHandle {
+  RtApiPipeWire *object;
+  struct pw_thread_loop *loop;
+  struct pw_stream *stream;
+  struct spa_hook listener;
+  unsigned int frameBytes;
+  PipeWireHandle() : object(0), loop(0), stream(0), frameBytes(0) { spa_zero( listener ); }
+};
+
+// Source nodes collected from the registry during enumeration.
+struct PipeWireDeviceList {
+  struct pw_main_loop *loop;
+  std::vector<RtAudio::DeviceInfo> devices;
+  std::vector<std::string> ids;
+  int seq;
+};
+
+static void rtaudio_pw_fill_info( RtAudio::DeviceInfo &info, unsigned int preferredRate )
+{
+  // The stream adapter resamples, so the standard rates are offered next to the node's own.
+  info.probed = true;
+  for ( const unsigned int *sr = PIPEWIRE_SAMPLERATES; *sr; ++sr )
+    info.sampleRates.push_back( *sr );
+  if ( std::find( info.sampleRates.begin(), info.sampleRates.end(), preferredRate ) == info.sampleRates.end() ) {
+    info.sampleRates.push_back( preferredRate );
+    std::sort( info.sampleRates.begin(), info.sampleRates.end() );
+  }
+  info.preferredSampleRate = preferredRate;
+  info.nativeFormats = RTAUDIO_SINT16 | RTAUDIO_SINT32 | RTAUDIO_FLOAT32;
+}
+
+static void rtaudio_pw_registry_global( void *data, uint32_t /*id*/, uint32_t /*permissions*/,
+                                        const char *type, uint32_t /*version*/, const struct spa_dict *props )
+{
+  PipeWireDeviceList *list = static_cast<PipeWireDeviceList *>( data );
+  if ( !props || strcmp( type, PW_TYPE_INTERFACE_Node ) != 0 ) return;
+
+  // Capture devices and virtual sources, null and loopback nodes included.
+  const char *mediaClass = spa_dict_lookup( props, PW_KEY_MEDIA_CLASS );
+  if ( !mediaClass || ( strcmp( mediaClass, "Audio/Source" ) != 0 &&
+                        strcmp( mediaClass, "Audio/Source/Virtual" ) != 0 &&
+                        strcmp( mediaClass, "Audio/Duplex" ) != 0 ) ) return;
+  const char *name = spa_dict_lookup( props, PW_KEY_NODE_NAME );
+  if ( !name ) return;
+  const char *description = spa_dict_lookup( props, PW_KEY_NODE_DESCRIPTION );
+  const char *channels = spa_dict_lookup( props, "audio.channels" );
+  const char *rate = spa_dict_lookup( props, "audio.rate" );
+
+  // Nodes that do not advertise a layout are offered as stereo, the
+  // adapter maps whatever they have.
+  RtAudio::DeviceInfo info;
+  info.name = description ? description : name;
+  info.inputChannels = channels ? std::max( atoi( channels ), 1 ) : 2;
+  rtaudio_pw_fill_info( info, ( rate && atoi( rate ) > 0 ) ? atoi( rate ) : 48000 );
+  list->devices.push_back( info );
+  list->ids.push_back( name );
+}
+
+static void rtaudio_pw_core_done( void *data, uint32_t id, int seq )
+{
+  PipeWireDeviceList *list = static_cast<PipeWireDeviceList *>( data );
+  if ( id == PW_ID_CORE && seq == list->seq ) pw_main_loop_quit( list->loop );
+}
+
+static void rtaudio_pw_core_error( void *data, uint32_t id, int /*seq*/, int /*res*/, const char * /*message*/ )
+{
+  PipeWireDeviceList *list = static_cast<PipeWireDeviceList *>( data );
+  if ( id == PW_ID_CORE ) pw_main_loop_quit( list->loop );
+}
+
+static void rtaudio_pw_stream_state( void *data, enum pw_stream_state /*old*/,
+                                     enum pw_stream_state /*state*/, const char * /*error*/ )
+{
+  pw_thread_loop_signal( static_cast<PipeWireHandle *>( data )->loop, false );
+}
+
+static void rtaudio_pw_stream_process( void *data )
+{
+  static_cast<PipeWireHandle *>( data )->object->callbackEvent();
+}
+
+// The event tables are filled by field, their layout grows between releases.
+static struct pw_core_events rtaudio_pw_make_core_events( void )
+{
+  struct pw_core_events events;
+  memset( &events, 0, sizeof( events ) );
+  events.version = PW_VERSION_CORE_EVENTS;
+  events.done = rtaudio_pw_core_done;
+  events.error = rtaudio_pw_core_error;
+  return events;
+}
+
+static struct pw_registry_events rtaudio_pw_make_registry_events( void )
+{
+  struct pw_registry_events events;
+  memset( &events, 0, sizeof( events ) );
+  events.version = PW_VERSION_REGISTRY_EVENTS;
+  events.global = rtaudio_pw_registry_global;
+  return events;
+}
+
+static struct pw_stream_events rtaudio_pw_make_stream_events( void )
+{
+  struct pw_stream_events events;
+  memset( &events, 0, sizeof( events ) );
+  events.version = PW_VERSION_STREAM_EVENTS;
+  events.state_changed = rtaudio_pw_stream_state;
+  events.process = rtaudio_pw_stream_process;
+  return events;
+}
+
+static const struct pw_core_events rtaudio_pw_core_events = rtaudio_pw_make_core_events();
+static const struct pw_registry_events rtaudio_pw_registry_events = rtaudio_pw_make_registry_events();
+static const struct pw_stream_events rtaudio_pw_stream_events = rtaudio_pw_make_stream_events();
+
+// Stops the loop first, after that the stream can be destroyed unlocked.
+static void rtaudio_pw_release( PipeWireHandle *handle )
+{
+  if ( handle->loop ) pw_thread_loop_stop( handle->loop );
+  if ( handle->stream ) pw_stream_destroy( handle->stream );
+  if ( handle->loop ) pw_thread_loop_destroy( handle->loop );
+  handle->stream = 0;
+  handle->loop = 0;
+}
+
+static void *pipewireStopStream( void *ptr )
+{
+  CallbackInfo *info = (CallbackInfo *) ptr;
+  RtApiPipeWire *object = (RtApiPipeWire *) info->object;
+
+  object->stopStream();
+  pthread_exit( NULL );
+}
+
+RtApiPipeWire :: RtApiPipeWire()
+{
+  pw_init( NULL, NULL );
+}
+
+RtApiPipeWire :: ~RtApiPipeWire()
+{
+  if ( stream_.state != STREAM_CLOSED ) closeStream();
+}
+
+void RtApiPipeWire :: saveDeviceInfo( void )
+{
+  // Device 0 follows the default source, the source nodes come after it.
+  // Without a running daemon nothing is listed.
+  devices_.clear();
+  deviceIds_.clear();
+
+  PipeWireDeviceList list;
+  list.seq = 0;
+  list.loop = pw_main_loop_new( NULL );
+  if ( !list.loop ) return;
+
+  struct pw_context *context = pw_context_new( pw_main_loop_get_loop( list.loop ), NULL, 0 );
+  struct pw_core *core = context ? pw_context_connect( context, NULL, 0 ) : NULL;
+  if ( core ) {
+    struct pw_registry *registry = pw_core_get_registry( core, PW_VERSION_REGISTRY, 0 );
+    struct spa_hook coreListener, registryListener;
+    spa_zero( coreListener );
+    spa_zero( registryListener );
+    pw_core_add_listener( core, &coreListener, &rtaudio_pw_core_events, &list );
+    pw_registry_add_listener( registry, &registryListener, &rtaudio_pw_registry_events, &list );
+
+    // Every existing node is announced before the sync completes.
+    list.seq = pw_core_sync( core, PW_ID_CORE, 0 );
+    pw_main_loop_run( list.loop );
+
+    spa_hook_remove( &registryListener );
+    spa_hook_remove( &coreListener );
+    pw_proxy_destroy( (struct pw_proxy *) registry );
+    pw_core_disconnect( core );
+
+    RtAudio::DeviceInfo defaultInfo;
+    defaultInfo.name = "PipeWire";
+    defaultInfo.inputChannels = 2;
+    defaultInfo.isDefaultInput = true;
+    rtaudio_pw_fill_info( defaultInfo, 48000 );
+    devices_.push_back( defaultInfo );
+    deviceIds_.push_back( std::string() );
+    devices_.insert( devices_.end(), list.devices.begin(), list.devices.end() );
+    deviceIds_.insert( deviceIds_.end(), list.ids.begin(), list.ids.end() );
+  }
+  if ( context ) pw_context_destroy( context );
+  pw_main_loop_destroy( list.loop );
+}
+
+unsigned int RtApiPipeWire :: getDeviceCount( void )
+{
+  saveDeviceInfo();
+  return devices_.size();
+}
+
+RtAudio::DeviceInfo RtApiPipeWire :: getDeviceInfo( unsigned int device )
+{
+  if ( device >= devices_.size() ) saveDeviceInfo();
+  if ( device >= devices_.size() ) {
+    errorText_ = "RtApiPipeWire::getDeviceInfo: device ID is invalid!";
+    error( RtAudioError::INVALID_USE );
+    return RtAudio::DeviceInfo();
+  }
+
+  return devices_[device];
+}
+
+void RtApiPipeWire :: callbackEvent( void )
+{
+  PipeWireHandle *handle = (PipeWireHandle *) stream_.apiHandle;
+  struct pw_buffer *buffer = pw_stream_dequeue_buffer( handle->stream );
+  if ( !buffer ) return;
+
+  struct spa_data *data = &buffer->buffer->datas[0];
+  if ( stream_.state != STREAM_RUNNING || !data->data || !data->chunk ) {
+    pw_stream_queue_buffer( handle->stream, buffer );
+    return;
+  }
+
+  uint32_t offset = std::min( data->chunk->offset, data->maxsize );
+  uint32_t size = std::min( data->chunk->size, data->maxsize - offset );
+  char *samples = (char *) data->data + offset;
+  unsigned long frames = size / handle->frameBytes;
+
+  // Without a format conversion the mapped buffer goes to the callback
+  // as is, a quantum longer than the buffer size is passed on in pieces.
+  RtAudioCallback callback = (RtAudioCallback) stream_.callbackInfo.callback;
+  int doStopStream = 0;
+  while ( frames > 0 && doStopStream == 0 ) {
+    unsigned int nFrames = std::min<unsigned long>( frames, stream_.bufferSize );
+    char *input = samples;
+    if ( stream_.doConvertBuffer[INPUT] ) {
+      convertBuffer( stream_.userBuffer[INPUT], samples, stream_.convertInfo[INPUT], nFrames );
+      input = stream_.userBuffer[INPUT];
+    }
+    doStopStream = callback( NULL, input, nFrames, getStreamTime(), 0, stream_.callbackInfo.userData );
+
+    stream_.streamTime += ( nFrames * 1.0 / stream_.sampleRate );
+#if defined( HAVE_GETTIMEOFDAY )
+    gettimeofday( &stream_.lastTickTimestamp, NULL );
+#endif
+    samples += nFrames * handle->frameBytes;
+    frames -= nFrames;
+  }
+
+  pw_stream_queue_buffer( handle->stream, buffer );
+
+  // Stopping takes the loop lock, the data thread hands that off.
+  if ( doStopStream ) {
+    stream_.state = STREAM_STOPPING;
+    ThreadHandle id;
+    if ( pthread_create( &id, NULL, pipewireStopStream, &stream_.callbackInfo ) == 0 )
+      pthread_detach( id );
+  }
+}
+
+void RtApiPipeWire :: startStream( void )
+{
+  PipeWireHandle *handle = (PipeWireHandle *) stream_.apiHandle;
+
+  verifyStream();
+  if ( stream_.state == STREAM_RUNNING ) {
+    errorText_ = "RtApiPipeWire::startStream(): the stream is already running!";
+    error( RtAudioError::WARNING );
+    return;
+  }
+
+  #if defined( HAVE_GETTIMEOFDAY )
+  gettimeofday( &stream_.lastTickTimestamp, NULL );
+  #endif
+
+  stream_.state = STREAM_RUNNING;
+  pw_thread_loop_lock( handle->loop );
+  pw_stream_set_active( handle->stream, true );
+  pw_thread_loop_unlock( handle->loop );
+}
+
+void RtApiPipeWire :: stopStream( void )
+{
+  PipeWireHandle *handle = (PipeWireHandle *) stream_.apiHandle;
+
+  verifyStream();
+  if ( stream_.state == STREAM_STOPPED ) {
+    errorText_ = "RtApiPipeWire::stopStream(): the stream is already stopped!";
+    error( RtAudioError::WARNING );
+    return;
+  }
+
+  stream_.state = STREAM_STOPPED;
+  pw_thread_loop_lock( handle->loop );
+  pw_stream_set_active( handle->stream, false );
+  pw_thread_loop_unlock( handle->loop );
+}
+
+void RtApiPipeWire :: abortStream( void )
+{
+  // A capture stream has nothing to drain.
+  stopStream();
+}
+
+void RtApiPipeWire :: closeStream( void )
+{
+  if ( stream_.state == STREAM_CLOSED ) {
+    errorText_ = "RtApiPipeWire::closeStream(): no open stream to close!";
+    error( RtAudioError::WARNING );
+    return;
+  }
+
+  PipeWireHandle *handle = (PipeWireHandle *) stream_.apiHandle;
+  stream_.state = STREAM_STOPPED;
+  if ( handle ) {
+    rtaudio_pw_release( handle );
+    delete handle;
+    stream_.apiHandle = 0;
+  }
+
+  for ( int i=0; i<2; i++ ) {
+    if ( stream_.userBuffer[i] ) {
+      free( stream_.userBuffer[i] );
+      stream_.userBuffer[i] = 0;
+    }
+  }
+
+  stream_.mode = UNINITIALIZED;
+  stream_.state = STREAM_CLOSED;
+}
+
+bool RtApiPipeWire :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigned int channels,
+                                       unsigned int firstChannel, unsigned int sampleRate,
+                                       RtAudioFormat format, unsigned int *bufferSize,
+                                       RtAudio::StreamOptions *options )
+{
+  PipeWireHandle *handle = 0;
+  unsigned long bufferBytes;
+  std::string streamName = "RtAudio";
+  struct pw_properties *props = 0;
+  uint8_t podBuffer[1024];
+  struct spa_pod_builder builder;
+  struct spa_audio_info_raw rawInfo;
+  const struct spa_pod *params[1];
+  enum pw_stream_state state = PW_STREAM_STATE_UNCONNECTED;
+  int flags = PW_STREAM_FLAG_AUTOCONNECT | PW_STREAM_FLAG_INACTIVE |
+    PW_STREAM_FLAG_MAP_BUFFERS | PW_STREAM_FLAG_RT_PROCESS;
+
+  if ( mode != INPUT ) {
+    errorText_ = "RtApiPipeWire::probeDeviceOpen: only input streams are supported.";
+    return FAILURE;
+  }
+
+  if ( device >= devices_.size() ) saveDeviceInfo();
+  if ( device >= devices_.size() ) {
+    errorText_ = "RtApiPipeWire::probeDeviceOpen: device ID is invalid!";
+    return FAILURE;
+  }
+
+  // Channels before the first one are captured as well and skipped by
+  // the buffer conversion.
+  if ( channels == 0 || channels + firstChannel > devices_[device].inputChannels ||
+       channels + firstChannel > SPA_AUDIO_MAX_CHANNELS ) {
+    errorText_ = "RtApiPipeWire::probeDeviceOpen: unsupported number of channels.";
+    return FAILURE;
+  }
+  if ( sampleRate == 0 ) {
+    errorText_ = "RtApiPipeWire::probeDeviceOpen: unsupported sample rate.";
+    return FAILURE;
+  }
+
+  memset( &rawInfo, 0, sizeof( rawInfo ) );
+  rawInfo.format = SPA_AUDIO_FORMAT_UNKNOWN;
+  for ( const rtaudio_pw_format_mapping_t *sf = pipewire_sampleformats; sf->rtaudio_format; ++sf ) {
+    if ( format == sf->rtaudio_format ) {
+      rawInfo.format = sf->pw_format;
+      break;
+    }
+  }
+  stream_.userFormat = format;
+  if ( rawInfo.format == SPA_AUDIO_FORMAT_UNKNOWN ) { // Use internal data format conversion.
+    rawInfo.format = SPA_AUDIO_FORMAT_F32;
+    stream_.deviceFormat[mode] = RTAUDIO_FLOAT32;
+  }
+  else
+    stream_.deviceFormat[mode] = format;
+
+  // Set other stream parameters.
+  if ( options && options->flags & RTAUDIO_NONINTERLEAVED ) stream_.userInterleaved = false;
+  else stream_.userInterleaved = true;
+  stream_.deviceInterleaved[mode] = true;
+  stream_.doByteSwap[mode] = false;
+  stream_.nUserChannels[mode] = channels;
+  stream_.nDeviceChannels[mode] = channels + firstChannel;
+  stream_.channelOffset[mode] = 0;
+  stream_.nBuffers = 1;
+
+  // Set flags for buffer conversion.
+  stream_.doConvertBuffer[mode] = false;
+  if ( stream_.userFormat != stream_.deviceFormat[mode] )
+    stream_.doConvertBuffer[mode] = true;
+  if ( stream_.nUserChannels[mode] < stream_.nDeviceChannels[mode] )
+    stream_.doConvertBuffer[mode] = true;
+  if ( stream_.userInterleaved != stream_.deviceInterleaved[mode] &&
+       stream_.nUserChannels[mode] > 1 )
+    stream_.doConvertBuffer[mode] = true;
+
+  // The user buffer only receives converted data, unconverted buffers
+  // are passed on in place.
+  bufferBytes = stream_.nUserChannels[mode] * *bufferSize * formatBytes( stream_.userFormat );
+  stream_.userBuffer[mode] = (char *) calloc( bufferBytes, 1 );
+  if ( stream_.userBuffer[mode] == NULL ) {
+    errorText_ = "RtApiPipeWire::probeDeviceOpen: error allocating user buffer memory.";
+    goto error;
+  }
+
+  stream_.bufferSize = *bufferSize;
+  stream_.sampleRate = sampleRate;
+  stream_.device[mode] = device;
+  if ( stream_.doConvertBuffer[mode] ) setConvertInfo( mode, firstChannel );
+
+  handle = new PipeWireHandle;
+  stream_.apiHandle = (void *) handle;
+  handle->object = this;
+  handle->frameBytes = stream_.nDeviceChannels[mode] * formatBytes( stream_.deviceFormat[mode] );
+  handle->loop = pw_thread_loop_new( "RtAudio", NULL );
+  if ( !handle->loop ) {
+    errorText_ = "RtApiPipeWire::probeDeviceOpen: error creating thread loop.";
+    goto error;
+  }
+
+  // The quantum follows the requested buffer size, the target is the
+  // node name, under both the current and the older property key.
+  if ( options && !options->streamName.empty() ) streamName = options->streamName;
+  props = pw_properties_new( PW_KEY_MEDIA_TYPE, "Audio", PW_KEY_MEDIA_CATEGORY, "Capture",
+                             PW_KEY_MEDIA_ROLE, "Production", NULL );
+  pw_properties_setf( props, PW_KEY_NODE_LATENCY, "%u/%u", *bufferSize, sampleRate );
+  if ( !deviceIds_[device].empty() ) {
+    pw_properties_set( props, "target.object", deviceIds_[device].c_str() );
+    pw_properties_set( props, "node.target", deviceIds_[device].c_str() );
+  }
+
+  rawInfo.rate = sampleRate;
+  rawInfo.channels = stream_.nDeviceChannels[mode];
+  for ( unsigned int i=0; i<rawInfo.channels; i++ )
+    rawInfo.position[i] = SPA_AUDIO_CHANNEL_AUX0 + i;
+  if ( rawInfo.channels == 1 )
+    rawInfo.position[0] = SPA_AUDIO_CHANNEL_MONO;
+  else if ( rawInfo.channels == 2 ) {
+    rawInfo.position[0] = SPA_AUDIO_CHANNEL_FL;
+    rawInfo.position[1] = SPA_AUDIO_CHANNEL_FR;
+  }
+  memset( &builder, 0, sizeof( builder ) );
+  builder.data = podBuffer;
+  builder.size = sizeof( podBuffer );
+  params[0] = spa_format_audio_raw_build( &builder, SPA_PARAM_EnumFormat, &rawInfo );
+
+  // The stream takes the properties, even when it cannot be created.
+  pw_thread_loop_lock( handle->loop );
+  handle->stream = pw_stream_new_simple( pw_thread_loop_get_loop( handle->loop ), streamName.c_str(),
+                                         props, &rtaudio_pw_stream_events, handle );
+  if ( handle->stream &&
+       pw_stream_connect( handle->stream, PW_DIRECTION_INPUT, PW_ID_ANY,
+                          (enum pw_stream_flags) flags, params, 1 ) == 0 &&
+       pw_thread_loop_start( handle->loop ) == 0 ) {
+    while ( ( state = pw_stream_get_state( handle->stream, NULL ) ) == PW_STREAM_STATE_CONNECTING ||
+            state == PW_STREAM_STATE_UNCONNECTED ) {
+      if ( pw_thread_loop_timed_wait( handle->loop, 5 ) != 0 ) break;
+    }
+  }
+  pw_thread_loop_unlock( handle->loop );
+
+  if ( state != PW_STREAM_STATE_PAUSED && state != PW_STREAM_STATE_STREAMING ) {
+    errorStream_ << "RtApiPipeWire::probeDeviceOpen: error connecting to node (" << devices_[device].name << ").";
+    errorText_ = errorStream_.str();
+    goto error;
+  }
+
+  stream_.mode = mode;
+  stream_.state = STREAM_STOPPED;
+  stream_.callbackInfo.object = (void *) this;
+  return SUCCESS;
+
+ error:
+  if ( handle ) {
+    rtaudio_pw_release( handle );
+    delete handle;
+    stream_.apiHandle = 0;
+  }
+
+  for ( int i=0; i<2; i++ ) {
+    if ( stream_.userBuffer[i] ) {
+      free( stream_.userBuffer[i] );
+      stream_.userBuffer[i] = 0;
+    }
+  }
+
+  stream_.state = STREAM_CLOSED;
+  return FAILURE;
+}
+
+//******************** End of __LINUX_PIPEWIRE__ *********************//
+#endif
+
 #if defined(__LINUX_OSS__)
 
 #include <unistd.h>
@@ -9985,6 +11181,7 @@ void RtApi :: clearStreamInfo()
   stream_.userFormat = 0;
   stream_.userInterleaved = true;
   stream_.streamTime = 0.0;
+  stream_.memoryLocked = false;
   stream_.apiHandle = 0;
   stream_.deviceBuffer = 0;
   stream_.callbackInfo.callback = 0;
@@ -10009,6 +11206,8 @@ void RtApi :: clearStreamInfo()
     stream_.convertInfo[i].outFormat = 0;
     stream_.convertInfo[i].inOffset.clear();
     stream_.convertInfo[i].outOffset.clear();
+    stream_.convertInfo[i].fastPath = false;
+    stream_.convertInfo[i].contiguous = false;
   }
 }
 
@@ -10109,9 +11308,142 @@ void RtApi :: setConvertInfo( StreamMode mode, unsigned int firstChannel )
       }
     }
   }
+
+  // The common conversions to float32 are dispatched to convertFast()
+  // once here, instead of per sample in the callback.  Runs into
+  // interleaved output stay with the generic loops, which write whole
+  // frames, as do float32 copies that gather more than one channel.
+  ConvertInfo &info = stream_.convertInfo[mode];
+  info.contiguous = info.inJump == info.channels && info.outJump == info.channels;
+  for ( int k=0; k<info.channels && info.contiguous; k++ )
+    info.contiguous = info.inOffset[k] == k && info.outOffset[k] == k;
+  info.fastPath = false;
+  if ( info.outFormat == RTAUDIO_FLOAT32 ) {
+    if ( info.inFormat == RTAUDIO_SINT16 || info.inFormat == RTAUDIO_SINT24 || info.inFormat == RTAUDIO_SINT32 )
+      info.fastPath = info.contiguous || info.outJump == 1;
+    else if ( info.inFormat == RTAUDIO_FLOAT32 )
+      info.fastPath = info.contiguous || ( info.outJump == 1 && info.channels == 1 );
+  }
+}
+
+// Runs of the fast conversions to float32.  Each converts n samples
+// spaced inStride and outStride apart, with the same arithmetic as the
+// generic loops in convertBuffer().  Runs into contiguous output use
+// SSE2 where the compiler targets it, four samples at a time.
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+  #include <emmintrin.h>
+  #define RTAUDIO_HAVE_SSE2
+#endif
+
+static void rtaudio_convert_run( float *out, int outStride, const signed short *in, int inStride, unsigned int n )
+{
+  const float scale = (float) ( 1.0 / 32767.5 );
+  unsigned int i = 0;
+#if defined(RTAUDIO_HAVE_SSE2)
+  const __m128 half = _mm_set1_ps( 0.5f ), vscale = _mm_set1_ps( scale );
+  if ( outStride == 1 && inStride == 1 ) {
+    for ( ; i + 8 <= n; i += 8 ) {
+      __m128i x = _mm_loadu_si128( (const __m128i *) ( in + i ) );
+      __m128i lo = _mm_srai_epi32( _mm_unpacklo_epi16( x, x ), 16 );
+      __m128i hi = _mm_srai_epi32( _mm_unpackhi_epi16( x, x ), 16 );
+      _mm_storeu_ps( out + i, _mm_mul_ps( _mm_add_ps( _mm_cvtepi32_ps( lo ), half ), vscale ) );
+      _mm_storeu_ps( out + i + 4, _mm_mul_ps( _mm_add_ps( _mm_cvtepi32_ps( hi ), half ), vscale ) );
+    }
+  }
+  else if ( outStride == 1 ) {
+    for ( ; i + 4 <= n; i += 4 ) {
+      const signed short *s = in + i * inStride;
+      __m128i x = _mm_set_epi32( s[3*inStride], s[2*inStride], s[inStride], s[0] );
+      _mm_storeu_ps( out + i, _mm_mul_ps( _mm_add_ps( _mm_cvtepi32_ps( x ), half ), vscale ) );
+    }
+  }
+#endif
+  for ( ; i < n; i++ )
+    out[i * outStride] = ( (float) in[i * inStride] + 0.5f ) * scale;
+}
+
+static void rtaudio_convert_run( float *out, int outStride, S24 *in, int inStride, unsigned int n )
+{
+  // Packed 24-bit samples are widened one by one in any case.
+  const float scale = (float) ( 1.0 / 8388607.5 );
+  unsigned int i = 0;
+#if defined(RTAUDIO_HAVE_SSE2)
+  const __m128 half = _mm_set1_ps( 0.5f ), vscale = _mm_set1_ps( scale );
+  if ( outStride == 1 ) {
+    for ( ; i + 4 <= n; i += 4 ) {
+      S24 *s = in + i * inStride;
+      __m128i x = _mm_set_epi32( s[3*inStride].asInt(), s[2*inStride].asInt(), s[inStride].asInt(), s[0].asInt() );
+      _mm_storeu_ps( out + i, _mm_mul_ps( _mm_add_ps( _mm_cvtepi32_ps( x ), half ), vscale ) );
+    }
+  }
+#endif
+  for ( ; i < n; i++ )
+    out[i * outStride] = ( (float) in[i * inStride].asInt() + 0.5f ) * scale;
+}
+
+static void rtaudio_convert_run( float *out, int outStride, const signed int *in, int inStride, unsigned int n )
+{
+  const float scale = (float) ( 1.0 / 2147483647.5 );
+  unsigned int i = 0;
+#if defined(RTAUDIO_HAVE_SSE2)
+  const __m128 half = _mm_set1_ps( 0.5f ), vscale = _mm_set1_ps( scale );
+  if ( outStride == 1 && inStride == 1 ) {
+    for ( ; i + 4 <= n; i += 4 ) {
+      __m128i x = _mm_loadu_si128( (const __m128i *) ( in + i ) );
+      _mm_storeu_ps( out + i, _mm_mul_ps( _mm_add_ps( _mm_cvtepi32_ps( x ), half ), vscale ) );
+    }
+  }
+  else if ( outStride == 1 ) {
+    for ( ; i + 4 <= n; i += 4 ) {
+      const signed int *s = in + i * inStride;
+      __m128i x = _mm_set_epi32( s[3*inStride], s[2*inStride], s[inStride], s[0] );
+      _mm_storeu_ps( out + i, _mm_mul_ps( _mm_add_ps( _mm_cvtepi32_ps( x ), half ), vscale ) );
+    }
+  }
+#endif
+  for ( ; i < n; i++ )
+    out[i * outStride] = ( (float) in[i * inStride] + 0.5f ) * scale;
+}
+
+static void rtaudio_convert_run( float *out, int outStride, const float *in, int inStride, unsigned int n )
+{
+  // Channel compensation and/or (de)interleaving only.
+  if ( outStride == 1 && inStride == 1 ) {
+    memcpy( out, in, n * sizeof( float ) );
+    return;
+  }
+  for ( unsigned int i=0; i<n; i++ )
+    out[i * outStride] = in[i * inStride];
+}
+
+void RtApi :: convertFast( char *outBuffer, char *inBuffer, ConvertInfo &info, unsigned int frames )
+{
+  // One run over everything when both sides hold the same channels back
+  // to back, otherwise one run per channel into its own output plane.
+  Float32 *out = (Float32 *) outBuffer;
+  int runs = info.contiguous ? 1 : info.channels;
+  unsigned int n = info.contiguous ? frames * info.channels : frames;
+  int inStride = info.contiguous ? 1 : info.inJump;
+  int outStride = info.contiguous ? 1 : info.outJump;
+
+  for ( int j=0; j<runs; j++ ) {
+    if ( info.inFormat == RTAUDIO_SINT16 )
+      rtaudio_convert_run( out + info.outOffset[j], outStride, (Int16 *) inBuffer + info.inOffset[j], inStride, n );
+    else if ( info.inFormat == RTAUDIO_SINT24 )
+      rtaudio_convert_run( out + info.outOffset[j], outStride, (Int24 *) inBuffer + info.inOffset[j], inStride, n );
+    else if ( info.inFormat == RTAUDIO_SINT32 )
+      rtaudio_convert_run( out + info.outOffset[j], outStride, (Int32 *) inBuffer + info.inOffset[j], inStride, n );
+    else
+      rtaudio_convert_run( out + info.outOffset[j], outStride, (Float32 *) inBuffer + info.inOffset[j], inStride, n );
+  }
 }
 
 void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info )
+{
+  convertBuffer( outBuffer, inBuffer, info, stream_.bufferSize );
+}
+
+void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info, unsigned int frames )
 {
   // This function does format conversion, input/output channel compensation, and
   // data interleaving/deinterleaving.  24-bit integers are assumed to occupy
@@ -10120,7 +11452,12 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
   // Clear our device buffer when in/out duplex device channels are different
   if ( outBuffer == stream_.deviceBuffer && stream_.mode == DUPLEX &&
        ( stream_.nDeviceChannels[0] < stream_.nDeviceChannels[1] ) )
-    memset( outBuffer, 0, stream_.bufferSize * info.outJump * formatBytes( info.outFormat ) );
+    memset( outBuffer, 0, frames * info.outJump * formatBytes( info.outFormat ) );
+
+  if ( info.fastPath ) {
+    convertFast( outBuffer, inBuffer, info, frames );
+    return;
+  }
 
   int j;
   if (info.outFormat == RTAUDIO_FLOAT64) {
@@ -10130,7 +11467,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     if (info.inFormat == RTAUDIO_SINT8) {
       signed char *in = (signed char *)inBuffer;
       scale = 1.0 / 127.5;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Float64) in[info.inOffset[j]];
           out[info.outOffset[j]] += 0.5;
@@ -10143,7 +11480,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     else if (info.inFormat == RTAUDIO_SINT16) {
       Int16 *in = (Int16 *)inBuffer;
       scale = 1.0 / 32767.5;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Float64) in[info.inOffset[j]];
           out[info.outOffset[j]] += 0.5;
@@ -10156,7 +11493,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     else if (info.inFormat == RTAUDIO_SINT24) {
       Int24 *in = (Int24 *)inBuffer;
       scale = 1.0 / 8388607.5;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Float64) (in[info.inOffset[j]].asInt());
           out[info.outOffset[j]] += 0.5;
@@ -10169,7 +11506,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     else if (info.inFormat == RTAUDIO_SINT32) {
       Int32 *in = (Int32 *)inBuffer;
       scale = 1.0 / 2147483647.5;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Float64) in[info.inOffset[j]];
           out[info.outOffset[j]] += 0.5;
@@ -10181,7 +11518,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_FLOAT32) {
       Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Float64) in[info.inOffset[j]];
         }
@@ -10192,7 +11529,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     else if (info.inFormat == RTAUDIO_FLOAT64) {
       // Channel compensation and/or (de)interleaving only.
       Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = in[info.inOffset[j]];
         }
@@ -10208,7 +11545,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     if (info.inFormat == RTAUDIO_SINT8) {
       signed char *in = (signed char *)inBuffer;
       scale = (Float32) ( 1.0 / 127.5 );
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Float32) in[info.inOffset[j]];
           out[info.outOffset[j]] += 0.5;
@@ -10221,7 +11558,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     else if (info.inFormat == RTAUDIO_SINT16) {
       Int16 *in = (Int16 *)inBuffer;
       scale = (Float32) ( 1.0 / 32767.5 );
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Float32) in[info.inOffset[j]];
           out[info.outOffset[j]] += 0.5;
@@ -10234,7 +11571,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     else if (info.inFormat == RTAUDIO_SINT24) {
       Int24 *in = (Int24 *)inBuffer;
       scale = (Float32) ( 1.0 / 8388607.5 );
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Float32) (in[info.inOffset[j]].asInt());
           out[info.outOffset[j]] += 0.5;
@@ -10247,7 +11584,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     else if (info.inFormat == RTAUDIO_SINT32) {
       Int32 *in = (Int32 *)inBuffer;
       scale = (Float32) ( 1.0 / 2147483647.5 );
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Float32) in[info.inOffset[j]];
           out[info.outOffset[j]] += 0.5;
@@ -10260,7 +11597,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     else if (info.inFormat == RTAUDIO_FLOAT32) {
       // Channel compensation and/or (de)interleaving only.
       Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = in[info.inOffset[j]];
         }
@@ -10270,7 +11607,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_FLOAT64) {
       Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Float32) in[info.inOffset[j]];
         }
@@ -10283,7 +11620,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     Int32 *out = (Int32 *)outBuffer;
     if (info.inFormat == RTAUDIO_SINT8) {
       signed char *in = (signed char *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int32) in[info.inOffset[j]];
           out[info.outOffset[j]] <<= 24;
@@ -10294,7 +11631,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_SINT16) {
       Int16 *in = (Int16 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int32) in[info.inOffset[j]];
           out[info.outOffset[j]] <<= 16;
@@ -10305,7 +11642,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_SINT24) {
       Int24 *in = (Int24 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int32) in[info.inOffset[j]].asInt();
           out[info.outOffset[j]] <<= 8;
@@ -10317,7 +11654,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     else if (info.inFormat == RTAUDIO_SINT32) {
       // Channel compensation and/or (de)interleaving only.
       Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = in[info.inOffset[j]];
         }
@@ -10327,7 +11664,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_FLOAT32) {
       Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int32) (in[info.inOffset[j]] * 2147483647.5 - 0.5);
         }
@@ -10337,7 +11674,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_FLOAT64) {
       Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int32) (in[info.inOffset[j]] * 2147483647.5 - 0.5);
         }
@@ -10350,7 +11687,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     Int24 *out = (Int24 *)outBuffer;
     if (info.inFormat == RTAUDIO_SINT8) {
       signed char *in = (signed char *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int32) (in[info.inOffset[j]] << 16);
           //out[info.outOffset[j]] <<= 16;
@@ -10361,7 +11698,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_SINT16) {
       Int16 *in = (Int16 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int32) (in[info.inOffset[j]] << 8);
           //out[info.outOffset[j]] <<= 8;
@@ -10373,7 +11710,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     else if (info.inFormat == RTAUDIO_SINT24) {
       // Channel compensation and/or (de)interleaving only.
       Int24 *in = (Int24 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = in[info.inOffset[j]];
         }
@@ -10383,7 +11720,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_SINT32) {
       Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int32) (in[info.inOffset[j]] >> 8);
           //out[info.outOffset[j]] >>= 8;
@@ -10394,7 +11731,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_FLOAT32) {
       Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int32) (in[info.inOffset[j]] * 8388607.5 - 0.5);
         }
@@ -10404,7 +11741,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_FLOAT64) {
       Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int32) (in[info.inOffset[j]] * 8388607.5 - 0.5);
         }
@@ -10417,7 +11754,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     Int16 *out = (Int16 *)outBuffer;
     if (info.inFormat == RTAUDIO_SINT8) {
       signed char *in = (signed char *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int16) in[info.inOffset[j]];
           out[info.outOffset[j]] <<= 8;
@@ -10429,7 +11766,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     else if (info.inFormat == RTAUDIO_SINT16) {
       // Channel compensation and/or (de)interleaving only.
       Int16 *in = (Int16 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = in[info.inOffset[j]];
         }
@@ -10439,7 +11776,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_SINT24) {
       Int24 *in = (Int24 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int16) (in[info.inOffset[j]].asInt() >> 8);
         }
@@ -10449,7 +11786,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_SINT32) {
       Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int16) ((in[info.inOffset[j]] >> 16) & 0x0000ffff);
         }
@@ -10459,7 +11796,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_FLOAT32) {
       Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int16) (in[info.inOffset[j]] * 32767.5 - 0.5);
         }
@@ -10469,7 +11806,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_FLOAT64) {
       Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int16) (in[info.inOffset[j]] * 32767.5 - 0.5);
         }
@@ -10483,7 +11820,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     if (info.inFormat == RTAUDIO_SINT8) {
       // Channel compensation and/or (de)interleaving only.
       signed char *in = (signed char *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = in[info.inOffset[j]];
         }
@@ -10493,7 +11830,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     if (info.inFormat == RTAUDIO_SINT16) {
       Int16 *in = (Int16 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (signed char) ((in[info.inOffset[j]] >> 8) & 0x00ff);
         }
@@ -10503,7 +11840,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_SINT24) {
       Int24 *in = (Int24 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (signed char) (in[info.inOffset[j]].asInt() >> 16);
         }
@@ -10513,7 +11850,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_SINT32) {
       Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (signed char) ((in[info.inOffset[j]] >> 24) & 0x000000ff);
         }
@@ -10523,7 +11860,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_FLOAT32) {
       Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (signed char) (in[info.inOffset[j]] * 127.5 - 0.5);
         }
@@ -10533,7 +11870,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_FLOAT64) {
       Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (signed char) (in[info.inOffset[j]] * 127.5 - 0.5);
         }
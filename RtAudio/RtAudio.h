@@ -102,6 +102,12 @@ static const RtAudioFormat RTAUDIO_FLOAT64 = 0x20; // Normalized between plus/mi
     - \e RTAUDIO_HOG_DEVICE:       Attempt grab device for exclusive use.
     - \e RTAUDIO_ALSA_USE_DEFAULT: Use the "default" PCM device (ALSA only).
     - \e RTAUDIO_JACK_DONT_CONNECT: Do not automatically connect ports (JACK only).
+    - \e RTAUDIO_ALSA_USE_MMAP:    Capture through the mmap'ed device buffer (ALSA only).
+    - \e RTAUDIO_ALSA_POLL_CAPTURE: Wait on the device poll descriptors and deliver variable chunks (ALSA only).
+    - \e RTAUDIO_JACK_SERVER_RATE: Open at the server rate when it differs from the requested one (JACK only).
+    - \e RTAUDIO_JACK_PORT_BUFFERS: Pass the input port buffers to the callback in place (JACK only).
+    - \e RTAUDIO_LOCK_MEMORY:      Lock the stream buffers into memory.
+    - \e RTAUDIO_ALSA_USE_PLUG:    Open the card through the plughw layer (ALSA only).
 
     By default, RtAudio streams pass and receive audio data from the
     client in an interleaved format.  By passing the
@@ -126,6 +132,8 @@ static const RtAudioFormat RTAUDIO_FLOAT64 = 0x20; // Normalized between plus/mi
     If the RTAUDIO_HOG_DEVICE flag is set, RtAudio will attempt to
     open the input and/or output stream device(s) for exclusive use.
     Note that this is not possible with all supported audio APIs.
+    With ALSA only the hw devices qualify, and a device that is busy
+    fails right away instead of blocking until it is released.
 
     If the RTAUDIO_SCHEDULE_REALTIME flag is set, RtAudio will attempt 
     to select realtime scheduling (round-robin) for the callback thread.
@@ -136,7 +144,45 @@ static const RtAudioFormat RTAUDIO_FLOAT64 = 0x20; // Normalized between plus/mi
 
     If the RTAUDIO_JACK_DONT_CONNECT flag is set, RtAudio will not attempt
     to automatically connect the ports of the client to the audio device.
+
+    If the RTAUDIO_ALSA_USE_MMAP flag is set, ALSA capture streams read
+    and convert straight out of the device DMA area instead of copying it
+    with snd_pcm_readi first. Devices without mmap access fall back to
+    the read/write interface.
+
+    If the RTAUDIO_ALSA_POLL_CAPTURE flag is set, an ALSA input stream
+    waits on the device poll descriptors instead of blocking in a read.
+    The callback thread wakes whenever avail_min frames are ready and
+    passes on everything available, up to one buffer, so \c nFrames in
+    the callback varies.  Duplex streams and non-interleaved layouts keep
+    the blocking read.
+
+    If the RTAUDIO_JACK_SERVER_RATE flag is set, a JACK stream opens at
+    the server rate instead of failing when the requested rate differs.
+    Use getStreamSampleRate() to find out which rate the stream runs at.
+
+    If the RTAUDIO_JACK_PORT_BUFFERS flag is set on a JACK input stream
+    of RTAUDIO_FLOAT32 data, the input buffer argument of the callback
+    is an array of \c float pointers, one per channel, to the JACK port
+    buffers themselves.  They are only valid during the callback, no
+    copy into an RtAudio buffer is made.  Duplex streams ignore the
+    flag.
+
+    If the RTAUDIO_LOCK_MEMORY flag is set, the user and device buffers
+    of the stream are locked into memory when it opens, so the callback
+    thread never takes a page fault on them.  A lock that is refused,
+    for instance by RLIMIT_MEMLOCK, is reported as a warning and
+    isStreamMemoryLocked() returns false.
+
+    If the RTAUDIO_ALSA_USE_PLUG flag is set, ALSA devices are opened
+    as plughw instead of hw, so the plug layer converts rates, formats
+    and channel counts the card does not support itself.
+
+    Flags and functions marked as SoapyAudio extensions are not part of
+    upstream RtAudio, RTAUDIO_SOAPY_EXTENSIONS is defined when they exist.
 */
+#define RTAUDIO_SOAPY_EXTENSIONS 1
+
 typedef unsigned int RtAudioStreamFlags;
 static const RtAudioStreamFlags RTAUDIO_NONINTERLEAVED = 0x1;    // Use non-interleaved buffers (default = interleaved).
 static const RtAudioStreamFlags RTAUDIO_MINIMIZE_LATENCY = 0x2;  // Attempt to set stream parameters for lowest possible latency.
@@ -144,6 +190,12 @@ static const RtAudioStreamFlags RTAUDIO_HOG_DEVICE = 0x4;        // Attempt grab
 static const RtAudioStreamFlags RTAUDIO_SCHEDULE_REALTIME = 0x8; // Try to select realtime scheduling for callback thread.
 static const RtAudioStreamFlags RTAUDIO_ALSA_USE_DEFAULT = 0x10; // Use the "default" PCM device (ALSA only).
 static const RtAudioStreamFlags RTAUDIO_JACK_DONT_CONNECT = 0x20; // Do not automatically connect ports (JACK only).
+static const RtAudioStreamFlags RTAUDIO_ALSA_USE_MMAP = 0x1000; // Capture from the mmap'ed device buffer (ALSA only, SoapyAudio extension).
+static const RtAudioStreamFlags RTAUDIO_ALSA_POLL_CAPTURE = 0x2000; // Poll driven capture with variable chunks (ALSA only, SoapyAudio extension).
+static const RtAudioStreamFlags RTAUDIO_JACK_SERVER_RATE = 0x4000; // Adopt the server sample rate (JACK only, SoapyAudio extension).
+static const RtAudioStreamFlags RTAUDIO_JACK_PORT_BUFFERS = 0x8000; // Pass input port buffers in place (JACK only, SoapyAudio extension).
+static const RtAudioStreamFlags RTAUDIO_LOCK_MEMORY = 0x10000; // Lock the stream buffers into memory (SoapyAudio extension).
+static const RtAudioStreamFlags RTAUDIO_ALSA_USE_PLUG = 0x20000; // Open the plughw device instead of hw (ALSA only, SoapyAudio extension).
 
 /*! \typedef typedef unsigned long RtAudioStreamStatus;
     \brief RtAudio stream status (over- or underflow) flags.
@@ -292,6 +344,7 @@ class RTAUDIO_DLL_PUBLIC RtAudio
     WINDOWS_ASIO,   /*!< The Steinberg Audio Stream I/O API. */
     WINDOWS_DS,     /*!< The Microsoft DirectSound API. */
     RTAUDIO_DUMMY,  /*!< A compilable but non-functional API. */
+    LINUX_PIPEWIRE, /*!< The native PipeWire API, capture only (SoapyAudio extension). */
     NUM_APIS        /*!< Number of values in this enum. */
   };
 
@@ -377,6 +430,16 @@ class RTAUDIO_DLL_PUBLIC RtAudio
     user is replaced during execution of the RtAudio::openStream()
     function by the value actually used by the system.
 
+    The \c availMin parameter sets how many frames must be available
+    before an ALSA capture or playback wakes up, zero leaves the driver
+    default.  Like \c numberOfBuffers it is replaced by the value the
+    device accepted (SoapyAudio extension, Linux Alsa API only).
+
+    The \c jackPorts parameter names the ports that the input channels
+    are connected to, full "client:port" names in channel order.  When
+    it is empty the ports of the selected device are used, starting at
+    the first channel (SoapyAudio extension, Jack API only).
+
     The \c streamName parameter can be used to set the client name
     when using the Jack API.  By default, the client name is set to
     RtApiJack.  However, if you wish to create multiple instances of
@@ -387,10 +450,12 @@ class RTAUDIO_DLL_PUBLIC RtAudio
     unsigned int numberOfBuffers;  /*!< Number of stream buffers. */
     std::string streamName;        /*!< A stream name (currently used only in Jack). */
     int priority;                  /*!< Scheduling priority of callback thread (only used with flag RTAUDIO_SCHEDULE_REALTIME). */
+    unsigned int availMin;         /*!< Wakeup threshold in frames (Alsa only, 0 = driver default). */
+    std::vector<std::string> jackPorts; /*!< Ports the input channels connect to, in channel order (Jack only, empty = the device's ports). */
 
     // Default constructor.
     StreamOptions()
-    : flags(0), numberOfBuffers(0), priority(0) {}
+    : flags(0), numberOfBuffers(0), priority(0), availMin(0) {}
   };
 
   //! A static function to determine the current RtAudio version.
@@ -606,6 +671,9 @@ class RTAUDIO_DLL_PUBLIC RtAudio
  */
   unsigned int getStreamSampleRate( void );
 
+  //! Returns true if the RTAUDIO_LOCK_MEMORY flag locked the stream buffers (SoapyAudio extension).
+  bool isStreamMemoryLocked( void ) const;
+
   //! Specify whether warning messages should be printed to stderr.
   void showWarnings( bool value = true );
 
@@ -628,7 +696,7 @@ class RTAUDIO_DLL_PUBLIC RtAudio
   typedef uintptr_t ThreadHandle;
   typedef CRITICAL_SECTION StreamMutex;
 
-#elif defined(__LINUX_ALSA__) || defined(__LINUX_PULSE__) || defined(__UNIX_JACK__) || defined(__LINUX_OSS__) || defined(__MACOSX_CORE__)
+#elif defined(__LINUX_ALSA__) || defined(__LINUX_PULSE__) || defined(__LINUX_PIPEWIRE__) || defined(__UNIX_JACK__) || defined(__LINUX_OSS__) || defined(__MACOSX_CORE__)
   // Using pthread library for various flavors of unix.
   #include <pthread.h>
 
@@ -738,6 +806,8 @@ public:
   virtual void setStreamTime( double time );
   bool isStreamOpen( void ) const { return stream_.state != STREAM_CLOSED; }
   bool isStreamRunning( void ) const { return stream_.state == STREAM_RUNNING; }
+  bool isStreamMemoryLocked( void ) const { return stream_.memoryLocked; }
+  void unlockStreamMemory( void );
   void showWarnings( bool value ) { showWarnings_ = value; }
 
 
@@ -769,6 +839,8 @@ protected:
     RtAudioFormat inFormat, outFormat;
     std::vector<int> inOffset;
     std::vector<int> outOffset;
+    bool fastPath;             // Conversion to float32 runs channel by channel (SoapyAudio extension).
+    bool contiguous;           // Both sides hold the same channels back to back, one run does it all.
   };
 
   // A protected structure for audio streams.
@@ -796,13 +868,14 @@ protected:
     CallbackInfo callbackInfo;
     ConvertInfo convertInfo[2];
     double streamTime;         // Number of elapsed seconds since the stream started.
+    bool memoryLocked;         // Buffers locked by RTAUDIO_LOCK_MEMORY (SoapyAudio extension).
 
 #if defined(HAVE_GETTIMEOFDAY)
     struct timeval lastTickTimestamp;
 #endif
 
     RtApiStream()
-      :apiHandle(0), deviceBuffer(0) { device[0] = 11111; device[1] = 11111; }
+      :apiHandle(0), deviceBuffer(0), memoryLocked(false) { device[0] = 11111; device[1] = 11111; }
   };
 
   typedef S24 Int24;
@@ -850,6 +923,12 @@ protected:
   */
   void convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info );
 
+  //! Same for a number of frames other than the stream buffer size.
+  void convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info, unsigned int frames );
+
+  //! The conversions to float32 picked by setConvertInfo(), vectorized where possible.
+  void convertFast( char *outBuffer, char *inBuffer, ConvertInfo &info, unsigned int frames );
+
   //! Protected common method used to perform byte-swapping on buffers.
   void byteSwapBuffer( char *buffer, unsigned int samples, RtAudioFormat format );
 
@@ -858,6 +937,9 @@ protected:
 
   //! Protected common method that sets up the parameters for buffer conversion.
   void setConvertInfo( StreamMode mode, unsigned int firstChannel );
+
+  //! Locks or unlocks the user and device buffers of the open stream, false if a lock failed.
+  bool lockStreamBuffers( bool lock );
 };
 
 // **************************************************************** //
@@ -871,7 +953,7 @@ inline unsigned int RtAudio :: getDeviceCount( void ) { return rtapi_->getDevice
 inline RtAudio::DeviceInfo RtAudio :: getDeviceInfo( unsigned int device ) { return rtapi_->getDeviceInfo( device ); }
 inline unsigned int RtAudio :: getDefaultInputDevice( void ) { return rtapi_->getDefaultInputDevice(); }
 inline unsigned int RtAudio :: getDefaultOutputDevice( void ) { return rtapi_->getDefaultOutputDevice(); }
-inline void RtAudio :: closeStream( void ) { return rtapi_->closeStream(); }
+inline void RtAudio :: closeStream( void ) { rtapi_->unlockStreamMemory(); return rtapi_->closeStream(); }
 inline void RtAudio :: startStream( void ) { return rtapi_->startStream(); }
 inline void RtAudio :: stopStream( void )  { return rtapi_->stopStream(); }
 inline void RtAudio :: abortStream( void ) { return rtapi_->abortStream(); }
@@ -879,6 +961,7 @@ inline bool RtAudio :: isStreamOpen( void ) const { return rtapi_->isStreamOpen(
 inline bool RtAudio :: isStreamRunning( void ) const { return rtapi_->isStreamRunning(); }
 inline long RtAudio :: getStreamLatency( void ) { return rtapi_->getStreamLatency(); }
 inline unsigned int RtAudio :: getStreamSampleRate( void ) { return rtapi_->getStreamSampleRate(); }
+inline bool RtAudio :: isStreamMemoryLocked( void ) const { return rtapi_->isStreamMemoryLocked(); }
 inline double RtAudio :: getStreamTime( void ) { return rtapi_->getStreamTime(); }
 inline void RtAudio :: setStreamTime( double time ) { return rtapi_->setStreamTime( time ); }
 inline void RtAudio :: showWarnings( bool value ) { rtapi_->showWarnings( value ); }
@@ -1098,6 +1181,8 @@ public:
                         unsigned int firstChannel, unsigned int sampleRate,
                         RtAudioFormat format, unsigned int *bufferSize,
                         RtAudio::StreamOptions *options );
+  int mmapCapture( struct _snd_pcm *handle, bool convert, unsigned long frames );
+  void pollCapture( void );
 };
 
 #endif
@@ -1125,6 +1210,44 @@ public:
   private:
 
   std::vector<RtAudio::DeviceInfo> devices_;
+  std::vector<std::string> deviceIds_;
+  void saveDeviceInfo( void );
+  bool probeDeviceOpen( unsigned int device, StreamMode mode, unsigned int channels,
+                        unsigned int firstChannel, unsigned int sampleRate,
+                        RtAudioFormat format, unsigned int *bufferSize,
+                        RtAudio::StreamOptions *options );
+};
+
+#endif
+
+#if defined(__LINUX_PIPEWIRE__)
+
+// Capture streams on pw_stream with mapped buffers, the user callback
+// runs on the PipeWire data thread (SoapyAudio extension).
+class RtApiPipeWire: public RtApi
+{
+public:
+
+  RtApiPipeWire();
+  ~RtApiPipeWire();
+  RtAudio::Api getCurrentApi() { return RtAudio::LINUX_PIPEWIRE; }
+  unsigned int getDeviceCount( void );
+  RtAudio::DeviceInfo getDeviceInfo( unsigned int device );
+  void closeStream( void );
+  void startStream( void );
+  void stopStream( void );
+  void abortStream( void );
+
+  // This function is intended for internal use only.  It must be
+  // public because it is called by the internal callback handler,
+  // which is not a member of RtAudio.  External use of this function
+  // will most likely produce highly undesireable results!
+  void callbackEvent( void );
+
+  private:
+
+  std::vector<RtAudio::DeviceInfo> devices_;
+  std::vector<std::string> deviceIds_;
   void saveDeviceInfo( void );
   bool probeDeviceOpen( unsigned int device, StreamMode mode, unsigned int channels,
                         unsigned int firstChannel, unsigned int sampleRate,
@@ -23,6 +23,7 @@
  */
 
 #include "SoapyAudio.hpp"
+#include "AudioDeviceCache.h"
 
 #ifdef USE_HAMLIB
 std::vector<const struct rig_caps *> SoapyAudio::rigCaps;
@@ -32,37 +33,110 @@ SoapyAudio::SoapyAudio(const SoapySDR::Kwargs &args)
 {
     deviceId = -1;
 
+    //only the selected backend is initialized, the default is the first compiled one
+    RtAudio::Api api = RtAudio::UNSPECIFIED;
+    if (args.count("api") != 0)
+    {
+        api = apiStrToEnum(args.at("api"));
+    }
+    dac.reset(new RtAudio(api));
+    txDac.reset(new RtAudio(dac->getCurrentApi()));
+
     asFormat = AUDIO_FORMAT_FLOAT32;
 
     sampleRate = 48000;
+    deviceRate = 48000;
+    decimation = 1;
+    resampleRatio = 1.0;
+    measuredRate.store(0);
+    rateCorrection.store(false);
     centerFrequency = 0;
+    ncoChanged.store(false);
 
     numBuffers = DEFAULT_NUM_BUFFERS;
+    alsaMmap = false;
+    alsaPoll = false;
+    periodFrames = 0;
+    periodCount = 0;
+    availMin = 0;
+    portBuffers = false;
+    planar = false;
+    schedPriority = 0;
+    lockMemory = false;
+    threadPending.store(false);
+    threadPolicy.store(-1);
+    threadPriority.store(0);
+    threadPinned.store(false);
+    memoryLocked.store(false);
 
     agcMode = false;
 
     bufferedElems = 0;
+    _buffCapacity = 0;
     resetBuffer = false;
+    _overflowEvent = false;
     
     streamActive = false;
-    sampleRateChanged.store(false);
+
+    rateThreadExit = false;
+    ratePending.store(false);
+    rateFailed.store(false);
+    rateStalled = false;
+    pendingRate = pendingDeviceRate = 0;
+    pendingDecimation = 1;
+    pendingRatio = 1.0;
+    chainsPending.store(false);
+    nextRate = 0;
+    nextDecimation = 1;
+    nextRatio = 1.0;
+    _discontinuity = false;
     
     sampleOffset = 0;
 
+    txFormat = AUDIO_FORMAT_FLOAT32;
+    txSetup = FORMAT_STEREO_IQ;
+    txSampleRate = 48000;
+    txBufferLength = DEFAULT_BUFFER_LENGTH;
+    txBurst.store(false);
+    txUnderflows.store(0);
+    txUnderflowsLogged = 0;
+    txUnderflowsReported = 0;
+    txReading = false;
+    txReadHandle = txReadOffset = txReadLength = 0;
+    txWriting = false;
+    txWriteHandle = txWriteOffset = 0;
+    duplexMode = false;
+    rxActive.store(false);
+    txActive.store(false);
+
+    deviceTicks.store(0);
+    timeBaseNs = 0;
+    aggregateDelay = 0;
+    clockTime = clockRate = 0;
+    clockTick = 0;
+    clockValid = false;
+    _currentElems = 0;
+    _currentTimeNs = 0;
+
+    std::vector<int> deviceIds;
+
     if (args.count("device_id") != 0)
     {
-        try {
-            deviceId = std::stoi(args.at("device_id"));
-        } catch (const std::invalid_argument &) {
-        }
+        //a list of ids aggregates several cards into one device
+        deviceIds = deviceIdStrToList(args.at("device_id"));
         
-        int numDevices = dac.getDeviceCount();
+        int numDevices = dac->getDeviceCount();
         
-        if (deviceId < 0 || deviceId >= numDevices)
+        for (auto id : deviceIds)
         {
-            throw std::runtime_error(
-                    "device_id out of range [0 .. " + std::to_string(numDevices) + "].");
+            if (id < 0 || id >= numDevices)
+            {
+                throw std::runtime_error(
+                        "device_id out of range [0 .. " + std::to_string(numDevices) + "].");
+            }
         }
+
+        if (!deviceIds.empty()) deviceId = deviceIds[0];
   
         SoapySDR_logf(SOAPY_SDR_DEBUG, "Found Audio device using 'device_id' = %d", deviceId);
     }
@@ -71,9 +145,136 @@ SoapyAudio::SoapyAudio(const SoapySDR::Kwargs &args)
         throw std::runtime_error("device_id missing.");
     }
 
-    RtAudio endac;
-    
-    devInfo = endac.getDeviceInfo(deviceId);
+    numChannelizerChannels = 0;
+    channelsChanged.store(false);
+
+    if (args.count("channelizer") != 0)
+    {
+        try {
+            numChannelizerChannels = std::stoi(args.at("channelizer"));
+        } catch (const std::invalid_argument &) {
+        }
+
+        if (!AudioChannelizer::isSupported(numChannelizerChannels))
+        {
+            throw std::runtime_error(
+                    "channelizer must be a power of two in [2 .. " + std::to_string(AUDIO_MAX_CHANNELIZER) + "].");
+        }
+
+        //sample rate is per channel, channels start out on their own bins
+        sampleRate = deviceRate / numChannelizerChannels;
+        channelFrequencies.assign(numChannelizerChannels, NAN);
+        channelBins.assign(numChannelizerChannels, 0);
+        channelNCOs.resize(numChannelizerChannels);
+    }
+
+    devInfo = audioProbeDevice(*dac, deviceId);
+
+    //one stream and callback for both directions keeps their periods aligned
+    if (args.count("duplex") != 0)
+    {
+        duplexMode = (args.at("duplex") == "true");
+        if (duplexMode && devInfo.duplexChannels == 0)
+        {
+            throw std::runtime_error("duplex requested but the device has no duplex channels.");
+        }
+        if (duplexMode && deviceIds.size() > 1)
+        {
+            throw std::runtime_error("duplex cannot be combined with an aggregate device.");
+        }
+    }
+
+    //how the card is opened, anything but hw lets ALSA convert behind our back,
+    //the flags only reach the stream on the ALSA backend
+    deviceFlags = 0;
+    const RtAudio::Api current = dac->getCurrentApi();
+    if (args.count("alsa_pcm") != 0)
+    {
+        const std::string &pcm = args.at("alsa_pcm");
+        if (pcm != "hw" && pcm != "plughw" && pcm != "default")
+        {
+            throw std::runtime_error("alsa_pcm must be one of hw, plughw or default.");
+        }
+        if (current != RtAudio::LINUX_ALSA)
+        {
+            SoapySDR_log(SOAPY_SDR_WARNING, "alsa_pcm only applies to the ALSA backend, ignored.");
+        }
+        else if (pcm == "default")
+        {
+            if (deviceIds.size() > 1)
+            {
+                throw std::runtime_error("alsa_pcm=default cannot be combined with an aggregate device.");
+            }
+            deviceFlags |= RTAUDIO_ALSA_USE_DEFAULT;
+        }
+        else if (pcm == "plughw")
+        {
+#ifdef RTAUDIO_SOAPY_EXTENSIONS
+            deviceFlags |= RTAUDIO_ALSA_USE_PLUG;
+#else
+            SoapySDR_log(SOAPY_SDR_WARNING, "alsa_pcm=plughw needs the bundled RtAudio, ignored.");
+#endif
+        }
+    }
+
+    if (args.count("exclusive") != 0 && args.at("exclusive") == "true")
+    {
+        //sound servers and the other backends share the card regardless
+        if (current != RtAudio::LINUX_ALSA && current != RtAudio::LINUX_OSS && current != RtAudio::MACOSX_CORE)
+        {
+            SoapySDR_logf(SOAPY_SDR_WARNING, "exclusive is not supported by the %s backend, ignored.",
+                    RtAudio::getApiDisplayName(current).c_str());
+        }
+        else if (deviceFlags != 0)
+        {
+            throw std::runtime_error("exclusive opens the card directly and needs alsa_pcm=hw.");
+        }
+        else
+        {
+            deviceFlags |= RTAUDIO_HOG_DEVICE;
+        }
+    }
+
+    //channel setup decides how many RX channels the inputs provide
+    cSetup = FORMAT_MONO_L;
+    if (args.count("chan") != 0)
+    {
+        cSetup = chanSetupStrToEnum(args.at("chan"));
+    }
+
+    for (size_t i = 1; i < deviceIds.size(); i++)
+    {
+        RtAudio::DeviceInfo cardInfo = audioProbeDevice(*dac, deviceIds[i]);
+        if (cardInfo.inputChannels != devInfo.inputChannels)
+        {
+            throw std::runtime_error("aggregate devices must have the same number of inputs.");
+        }
+
+        std::unique_ptr<AudioAggregateCard> card(new AudioAggregateCard());
+        card->owner = this;
+        card->deviceId = deviceIds[i];
+        card->dac.reset(new RtAudio(dac->getCurrentApi()));
+        card->startTick.store(0);
+        card->drift.store(0);
+        card->threadPending.store(false);
+        card->fifoEndTick = 0;
+        card->aligned = false;
+        aggregateCards.push_back(std::move(card));
+
+        SoapySDR_logf(SOAPY_SDR_DEBUG, "Aggregating Audio device %d", deviceIds[i]);
+    }
+
+    if (!aggregateCards.empty() && numChannelizerChannels)
+    {
+        throw std::runtime_error("channelizer cannot be combined with an aggregate device.");
+    }
+
+    bbFrequencies.assign(std::max<unsigned int>(devInfo.inputChannels, 1) * (aggregateCards.size() + 1), 0.0);
+
+    if (numChannelizerChannels && (cSetup == FORMAT_MULTI_MONO || cSetup == FORMAT_MULTI_IQ || cSetup == FORMAT_MULTI_QI || cSetup == FORMAT_DUAL_MONO))
+    {
+        throw std::runtime_error("channelizer requires a single channel setup.");
+    }
     
 #ifdef USE_HAMLIB
     t_Rig = nullptr;
@@ -108,6 +309,16 @@ SoapyAudio::SoapyAudio(const SoapySDR::Kwargs &args)
 
 SoapyAudio::~SoapyAudio(void)
 {
+    if (rateThread.joinable())
+    {
+        {
+            std::unique_lock<std::mutex> lock(_rate_mutex);
+            rateThreadExit = true;
+        }
+        _rate_cond.notify_one();
+        rateThread.join();
+    }
+
 #ifdef USE_HAMLIB
     if (rigThread) {
         if (!rigThread->isTerminated()) {
@@ -142,6 +353,7 @@ SoapySDR::Kwargs SoapyAudio::getHardwareInfo(void) const
 
     args["origin"] = "https://github.com/pothosware/SoapyAudio";
     args["device_id"] = std::to_string(deviceId);
+    args["api"] = RtAudio::getApiName(dac->getCurrentApi());
 
     return args;
 }
@@ -152,7 +364,28 @@ SoapySDR::Kwargs SoapyAudio::getHardwareInfo(void) const
 
 size_t SoapyAudio::getNumChannels(const int dir) const
 {
-    return (dir == SOAPY_SDR_RX) ? 1 : 0;
+    //a single complex output built from one or both outputs
+    if (dir == SOAPY_SDR_TX) return (devInfo.outputChannels > 0) ? 1 : 0;
+    if (dir != SOAPY_SDR_RX) return 0;
+    if (numChannelizerChannels) return numChannelizerChannels;
+
+    //aggregate cards follow each other in channel order
+    return getNumCardChannels() * (aggregateCards.size() + 1);
+}
+
+size_t SoapyAudio::getNumCardChannels(void) const
+{
+    switch (cSetup) {
+        case FORMAT_DUAL_MONO:
+            return 2;
+        case FORMAT_MULTI_MONO:
+            return std::max<unsigned int>(devInfo.inputChannels, 1);
+        case FORMAT_MULTI_IQ:
+        case FORMAT_MULTI_QI:
+            return std::max<unsigned int>(devInfo.inputChannels / 2, 1);
+        default:
+            return 1;
+    }
 }
 
 /*******************************************************************
@@ -162,8 +395,7 @@ size_t SoapyAudio::getNumChannels(const int dir) const
 std::vector<std::string> SoapyAudio::listAntennas(const int direction, const size_t channel) const
 {
     std::vector<std::string> antennas;
-    antennas.push_back("RX");
-    // antennas.push_back("TX");
+    antennas.push_back((direction == SOAPY_SDR_TX) ? "TX" : "RX");
     return antennas;
 }
 
@@ -174,8 +406,7 @@ void SoapyAudio::setAntenna(const int direction, const size_t channel, const std
 
 std::string SoapyAudio::getAntenna(const int direction, const size_t channel) const
 {
-    return "RX";
-    // return "TX";
+    return (direction == SOAPY_SDR_TX) ? "TX" : "RX";
 }
 
 /*******************************************************************
@@ -273,6 +504,24 @@ void SoapyAudio::setFrequency(
         }
 #endif
     }
+    else if (direction != SOAPY_SDR_RX)
+    {
+        return;
+    }
+    else if (name == "BB" && numChannelizerChannels)
+    {
+        if (channel >= numChannelizerChannels) return;
+        channelFrequencies[channel] = frequency;
+        channelsChanged.store(true);
+        SoapySDR_logf(SOAPY_SDR_DEBUG, "Setting channel %d baseband freq: %f", (int) channel, frequency);
+    }
+    else if (name == "BB")
+    {
+        if (channel >= bbFrequencies.size()) return;
+        bbFrequencies[channel] = frequency;
+        ncoChanged.store(true);
+        SoapySDR_logf(SOAPY_SDR_DEBUG, "Setting baseband freq: %f", frequency);
+    }
 }
 
 double SoapyAudio::getFrequency(const int direction, const size_t channel, const std::string &name) const
@@ -286,14 +535,40 @@ double SoapyAudio::getFrequency(const int direction, const size_t channel, const
 #endif
         return (double) centerFrequency;
     }
+    else if (direction != SOAPY_SDR_RX)
+    {
+        return 0;
+    }
+    else if (name == "BB" && numChannelizerChannels)
+    {
+        return getChannelFrequency(channel);
+    }
+    else if (name == "BB")
+    {
+        return (channel < bbFrequencies.size()) ? bbFrequencies[channel] : 0;
+    }
 
     return 0;
 }
 
+double SoapyAudio::getChannelFrequency(const size_t channel) const
+{
+    if (channel >= numChannelizerChannels) return 0;
+
+    //untuned channels report the center of their own bin
+    if (std::isnan(channelFrequencies[channel]))
+    {
+        const long bin = (channel < numChannelizerChannels / 2) ? long(channel) : long(channel) - long(numChannelizerChannels);
+        return double(bin) * sampleRate;
+    }
+    return channelFrequencies[channel];
+}
+
 std::vector<std::string> SoapyAudio::listFrequencies(const int direction, const size_t channel) const
 {
     std::vector<std::string> names;
     names.push_back("RF");
+    if (direction == SOAPY_SDR_RX) names.push_back("BB");
     return names;
 }
 
@@ -307,6 +582,11 @@ SoapySDR::RangeList SoapyAudio::getFrequencyRange(
     {
         results.push_back(SoapySDR::Range(0, 6000000000));
     }
+    else if (name == "BB")
+    {
+        const double wideRate = numChannelizerChannels ? double(sampleRate) * numChannelizerChannels : double(deviceRate);
+        results.push_back(SoapySDR::Range(-wideRate / 2, wideRate / 2));
+    }
     return results;
 }
 
@@ -323,19 +603,135 @@ SoapySDR::ArgInfoList SoapyAudio::getFrequencyArgsInfo(const int direction, cons
  * Sample Rate API
  ******************************************************************/
 
+void SoapyAudio::selectDeviceRate(const uint32_t rate, const std::vector<unsigned int> &deviceRates,
+        uint32_t &devRate, size_t &decim, double &ratio) const
+{
+    devRate = rate;
+    decim = 1;
+    ratio = 1.0;
+
+    std::vector<unsigned int> rates = deviceRates;
+    if (rate == 0 || rates.empty() || std::find(rates.begin(), rates.end(), rate) != rates.end()) {
+        return;
+    }
+
+    //pick the native rate and decimation with the cheapest filter chain,
+    //exact divisions skip the resampler, anything else resamples by (0.5, 1]
+    std::sort(rates.begin(), rates.end());
+    double bestCost = -1;
+    for (auto r : rates) {
+        if (r < rate) continue;
+
+        size_t d = 1;
+        double candidateRatio = 1.0;
+        double candidateCost = 0;
+
+        if ((r % rate) == 0 && AudioDecimator::isSupported(r / rate)) {
+            d = r / rate;
+            candidateCost = AudioDecimator::cost(d, rate);
+        } else {
+            while (AudioDecimator::isSupported(d * 2) && double(r) / (d * 2) >= rate) d *= 2;
+            candidateRatio = double(rate) / (double(r) / d);
+            candidateCost = AudioDecimator::cost(d, double(r) / d) + AudioResampler::cost(rate);
+        }
+
+        if (bestCost < 0 || candidateCost < bestCost) {
+            bestCost = candidateCost;
+            devRate = r;
+            decim = d;
+            ratio = candidateRatio;
+        }
+    }
+
+    if (bestCost < 0) {
+        throw std::runtime_error("setSampleRate " + std::to_string(rate) + " out of range [" +
+                std::to_string(rates.front() / AUDIO_MAX_DECIMATION) + " .. " + std::to_string(rates.back()) + "].");
+    }
+}
+
+void SoapyAudio::adoptDeviceRate(const uint32_t rate)
+{
+    //the device opened at a rate of its own choosing, a jack server for one,
+    //the chain is rebuilt around it and the stream rate stays as requested
+    const uint32_t wideRate = sampleRate * std::max<size_t>(numChannelizerChannels, 1);
+    if (rate < wideRate) {
+        throw std::runtime_error("Device runs at " + std::to_string(rate) + " Hz, below the requested rate " + std::to_string(wideRate) + ".");
+    }
+
+    //the probed rates stay as they are for later rate changes
+    uint32_t newDeviceRate;
+    size_t newDecimation;
+    double newRatio;
+    selectDeviceRate(wideRate, std::vector<unsigned int>(1, rate), newDeviceRate, newDecimation, newRatio);
+    deviceRate = newDeviceRate;
+    decimation = newDecimation;
+    resampleRatio = newRatio;
+    configureDSP();
+
+    SoapySDR_logf(SOAPY_SDR_INFO, "Device runs at %u Hz, decimated by %d, resampled by %f",
+            deviceRate.load(), (int) decimation, resampleRatio.load());
+}
+
 void SoapyAudio::setSampleRate(const int direction, const size_t channel, const double rate)
 {
-    SoapySDR_logf(SOAPY_SDR_DEBUG, "Setting sample rate: %d", sampleRate);
+    SoapySDR_logf(SOAPY_SDR_DEBUG, "Setting sample rate: %d", (uint32_t) rate);
 
-    if (sampleRate != rate) {
-        sampleRate = rate;
-        resetBuffer = true;
-        sampleRateChanged.store(true);
+    //transmit runs at a native rate, there is no interpolation chain
+    if (direction == SOAPY_SDR_TX)
+    {
+        if (duplexMode && (uint32_t) rate != deviceRate) {
+            throw std::runtime_error("setSampleRate TX must match the device rate " + std::to_string(deviceRate) + " in duplex mode.");
+        }
+        const std::vector<unsigned int> &rates = devInfo.sampleRates;
+        if (!rates.empty() && std::find(rates.begin(), rates.end(), (unsigned int) rate) == rates.end()) {
+            throw std::runtime_error("setSampleRate " + std::to_string((uint32_t) rate) + " is not a native TX rate.");
+        }
+        txSampleRate = rate;
+        return;
     }
+
+    uint32_t newDeviceRate;
+    size_t newDecimation;
+    double newRatio;
+
+    //the channelizer runs at the combined rate of all its channels
+    const uint32_t wideRate = (uint32_t) rate * std::max<size_t>(numChannelizerChannels, 1);
+    selectDeviceRate(wideRate, devInfo.sampleRates, newDeviceRate, newDecimation, newRatio);
+
+    if (newDeviceRate != wideRate) {
+        SoapySDR_logf(SOAPY_SDR_DEBUG, "Device rate %d decimated by %d, resampled by %f",
+                newDeviceRate, (int) newDecimation, newRatio);
+    }
+
+    if (getSampleRate(direction, channel) == rate) return;
+
+    std::unique_lock<std::mutex> lock(_rate_mutex);
+
+    //while streaming the control thread reconfigures, the reader is never blocked
+    if (rxActive.load()) {
+        pendingRate = rate;
+        pendingDeviceRate = newDeviceRate;
+        pendingDecimation = newDecimation;
+        pendingRatio = newRatio;
+        ratePending.store(true);
+        _rate_cond.notify_one();
+        return;
+    }
+
+    sampleRate = rate;
+    deviceRate = newDeviceRate;
+    decimation = newDecimation;
+    resampleRatio = newRatio;
+    resetBuffer = true;
+    ncoChanged.store(true);
+    channelsChanged.store(true);
 }
 
 double SoapyAudio::getSampleRate(const int direction, const size_t channel) const
 {
+    if (direction == SOAPY_SDR_TX) return duplexMode ? deviceRate.load() : txSampleRate;
+    if (ratePending.load()) return pendingRate;
+    if (chainsPending.load()) return nextRate;
     return sampleRate;
 }
 
@@ -343,17 +739,55 @@ std::vector<double> SoapyAudio::listSampleRates(const int direction, const size_
 {
     std::vector<double> results;
 
-    RtAudio endac;
-    RtAudio::DeviceInfo info = endac.getDeviceInfo(deviceId);
+    //shared probe results, refreshed only when the hardware changed
+    RtAudio::DeviceInfo info = audioProbeDevice(*dac, deviceId);
 
     std::vector<unsigned int>::iterator srate;
 
     for (srate = info.sampleRates.begin(); srate != info.sampleRates.end(); srate++) {
         results.push_back(*srate);
+        if (direction == SOAPY_SDR_TX) continue;
+
+        //rates reachable through the halfband cascade
+        for (unsigned int decim = 2; decim <= AUDIO_MAX_DECIMATION; decim *= 2) {
+            if ((*srate % decim) == 0) {
+                results.push_back(*srate / decim);
+            }
+        }
+    }
+
+    //channelizer outputs split the rate between all channels
+    if (numChannelizerChannels && direction == SOAPY_SDR_RX) {
+        for (auto &rate : results) rate /= numChannelizerChannels;
+    }
+
+    std::sort(results.begin(), results.end());
+    results.erase(std::unique(results.begin(), results.end()), results.end());
+
+    return results;
+}
+
+#ifdef SOAPY_SDR_API_HAS_GET_SAMPLE_RATE_RANGE
+SoapySDR::RangeList SoapyAudio::getSampleRateRange(const int direction, const size_t channel) const
+{
+    SoapySDR::RangeList results;
+
+    std::vector<unsigned int> rates = devInfo.sampleRates;
+    if (rates.empty()) return results;
+
+    if (direction == SOAPY_SDR_TX) {
+        for (auto rate : rates) results.push_back(SoapySDR::Range(rate, rate));
+        return results;
     }
 
+    //any rate below the fastest native rate is reached by resampling
+    std::sort(rates.begin(), rates.end());
+    const double numChans = std::max<size_t>(numChannelizerChannels, 1);
+    results.push_back(SoapySDR::Range(rates.front() / AUDIO_MAX_DECIMATION / numChans, rates.back() / numChans));
+
     return results;
 }
+#endif
 
 void SoapyAudio::setBandwidth(const int direction, const size_t channel, const double bw)
 {
@@ -372,6 +806,22 @@ std::vector<double> SoapyAudio::listBandwidths(const int direction, const size_t
     return results;
 }
 
+/*******************************************************************
+ * Time API
+ ******************************************************************/
+
+bool SoapyAudio::hasHardwareTime(const std::string &what) const
+{
+    return what.empty();
+}
+
+long long SoapyAudio::getHardwareTime(const std::string &what) const
+{
+    //time is counted in frames of the (first) device
+    std::unique_lock<std::mutex> lock(_time_mutex);
+    return timeBaseNs + (long long)(deviceTicks.load() * (1e9 / deviceRate));
+}
+
 /*******************************************************************
  * Settings API
  ******************************************************************/
@@ -407,6 +857,129 @@ SoapySDR::ArgInfoList SoapyAudio::getSettingInfo(void) const
 
     setArgs.push_back(sampleOffsetArg);
 
+    // Rates (read-only)
+    SoapySDR::ArgInfo deviceRateArg;
+    deviceRateArg.key = "device_rate";
+    deviceRateArg.value = std::to_string(deviceRate);
+    deviceRateArg.name = "Device Sample Rate";
+    deviceRateArg.description = "Rate the audio device runs at (read-only).";
+    deviceRateArg.units = "Hz";
+    deviceRateArg.type = SoapySDR::ArgInfo::INT;
+
+    setArgs.push_back(deviceRateArg);
+
+    SoapySDR::ArgInfo outputRateArg;
+    outputRateArg.key = "output_rate";
+    outputRateArg.value = std::to_string(sampleRate);
+    outputRateArg.name = "Output Sample Rate";
+    outputRateArg.description = "Rate delivered after decimation and resampling (read-only).";
+    outputRateArg.units = "Hz";
+    outputRateArg.type = SoapySDR::ArgInfo::INT;
+
+    setArgs.push_back(outputRateArg);
+
+    SoapySDR::ArgInfo measuredRateArg;
+    measuredRateArg.key = "measured_rate";
+    measuredRateArg.value = "0";
+    measuredRateArg.name = "Measured Device Rate";
+    measuredRateArg.description = "Device rate estimated against the host clock (read-only).";
+    measuredRateArg.units = "Hz";
+    measuredRateArg.type = SoapySDR::ArgInfo::FLOAT;
+
+    setArgs.push_back(measuredRateArg);
+
+    // Buffer geometry negotiated with the device (read-only)
+    SoapySDR::ArgInfo periodFramesArg;
+    periodFramesArg.key = "period_frames";
+    periodFramesArg.value = std::to_string(bufferLength);
+    periodFramesArg.name = "Period Frames";
+    periodFramesArg.description = "Frames per period the device accepted (read-only).";
+    periodFramesArg.units = "frames";
+    periodFramesArg.type = SoapySDR::ArgInfo::INT;
+
+    setArgs.push_back(periodFramesArg);
+
+    SoapySDR::ArgInfo periodsArg;
+    periodsArg.key = "periods";
+    periodsArg.value = std::to_string(opts.numberOfBuffers);
+    periodsArg.name = "Periods";
+    periodsArg.description = "Periods in the device buffer the device accepted (read-only).";
+    periodsArg.type = SoapySDR::ArgInfo::INT;
+
+    setArgs.push_back(periodsArg);
+
+#ifdef RTAUDIO_SOAPY_EXTENSIONS
+    SoapySDR::ArgInfo availMinArg;
+    availMinArg.key = "avail_min";
+    availMinArg.value = std::to_string(opts.availMin);
+    availMinArg.name = "ALSA avail_min";
+    availMinArg.description = "Frames available before the capture wakes up (read-only, ALSA only).";
+    availMinArg.units = "frames";
+    availMinArg.type = SoapySDR::ArgInfo::INT;
+
+    setArgs.push_back(availMinArg);
+#endif
+
+    // Capture thread as it runs (read-only)
+    SoapySDR::ArgInfo threadSchedArg;
+    threadSchedArg.key = "thread_sched";
+    threadSchedArg.value = "";
+    threadSchedArg.name = "Capture Scheduling";
+    threadSchedArg.description = "Scheduling class and priority of the capture thread (read-only).";
+    threadSchedArg.type = SoapySDR::ArgInfo::STRING;
+
+    setArgs.push_back(threadSchedArg);
+
+    SoapySDR::ArgInfo threadAffinityArg;
+    threadAffinityArg.key = "thread_affinity";
+    threadAffinityArg.value = "";
+    threadAffinityArg.name = "Capture CPU Affinity";
+    threadAffinityArg.description = "CPUs the capture thread is pinned to, empty if unpinned (read-only).";
+    threadAffinityArg.type = SoapySDR::ArgInfo::STRING;
+
+    setArgs.push_back(threadAffinityArg);
+
+    SoapySDR::ArgInfo memoryLockedArg;
+    memoryLockedArg.key = "memory_locked";
+    memoryLockedArg.value = "false";
+    memoryLockedArg.name = "Buffers Locked";
+    memoryLockedArg.description = "Whether the sample ring and the device buffers are locked into memory (read-only).";
+    memoryLockedArg.type = SoapySDR::ArgInfo::BOOL;
+
+    setArgs.push_back(memoryLockedArg);
+
+    SoapySDR::ArgInfo rateCorrectionArg;
+    rateCorrectionArg.key = "rate_correction";
+    rateCorrectionArg.value = "false";
+    rateCorrectionArg.name = "Rate Correction";
+    rateCorrectionArg.description = "Resample the measured device rate to the exact nominal rate.";
+    rateCorrectionArg.type = SoapySDR::ArgInfo::BOOL;
+
+    setArgs.push_back(rateCorrectionArg);
+
+    if (!aggregateCards.empty())
+    {
+        SoapySDR::ArgInfo aggregateOffsetsArg;
+        aggregateOffsetsArg.key = "aggregate_offsets";
+        aggregateOffsetsArg.value = "";
+        aggregateOffsetsArg.name = "Aggregate Start Offsets";
+        aggregateOffsetsArg.description = "Start of each additional card on the first card's timeline, comma separated (read-only).";
+        aggregateOffsetsArg.units = "samples";
+        aggregateOffsetsArg.type = SoapySDR::ArgInfo::STRING;
+
+        setArgs.push_back(aggregateOffsetsArg);
+
+        SoapySDR::ArgInfo aggregateDriftArg;
+        aggregateDriftArg.key = "aggregate_drift";
+        aggregateDriftArg.value = "";
+        aggregateDriftArg.name = "Aggregate Clock Drift";
+        aggregateDriftArg.description = "Clock of each additional card against the first card, comma separated (read-only).";
+        aggregateDriftArg.units = "ppm";
+        aggregateDriftArg.type = SoapySDR::ArgInfo::STRING;
+
+        setArgs.push_back(aggregateDriftArg);
+    }
+
 #ifdef USE_HAMLIB
     // Rig Control
     SoapySDR::ArgInfo rigArg;
@@ -496,6 +1069,10 @@ void SoapyAudio::writeSetting(const std::string &key, const std::string &value)
             }
         } catch (const std::invalid_argument &) { }
     }
+
+    if (key == "rate_correction") {
+        rateCorrection.store(value == "true");
+    }
     
     
 #ifdef USE_HAMLIB   
@@ -548,6 +1125,52 @@ std::string SoapyAudio::readSetting(const std::string &key) const
     if (key == "sample_offset") {
         return std::to_string(sampleOffset);
     }
+    if (key == "device_rate") {
+        return std::to_string(deviceRate);
+    }
+    if (key == "output_rate") {
+        return std::to_string(sampleRate);
+    }
+    if (key == "measured_rate") {
+        return std::to_string(measuredRate.load());
+    }
+    if (key == "rate_correction") {
+        return rateCorrection.load() ? "true" : "false";
+    }
+    if (key == "period_frames") {
+        return std::to_string(bufferLength);
+    }
+    if (key == "periods") {
+        return std::to_string(opts.numberOfBuffers);
+    }
+#ifdef RTAUDIO_SOAPY_EXTENSIONS
+    if (key == "avail_min") {
+        return std::to_string(opts.availMin);
+    }
+#endif
+    if (key == "thread_sched") {
+        return captureThreadPolicy();
+    }
+    if (key == "thread_affinity") {
+        std::string cpus;
+        if (!threadPinned.load()) return cpus;
+        for (auto cpu : cpuAffinity) {
+            if (!cpus.empty()) cpus += ",";
+            cpus += std::to_string(cpu);
+        }
+        return cpus;
+    }
+    if (key == "memory_locked") {
+        return memoryLocked.load() ? "true" : "false";
+    }
+    if (key == "aggregate_offsets" || key == "aggregate_drift") {
+        std::string values;
+        for (auto &card : aggregateCards) {
+            if (!values.empty()) values += ",";
+            values += std::to_string((key == "aggregate_offsets") ? card->startTick.load() : card->drift.load());
+        }
+        return values;
+    }
     
 #ifdef USE_HAMLIB
     if (key == "rig")
@@ -577,11 +1200,46 @@ chanSetup SoapyAudio::chanSetupStrToEnum(std::string chanOpt) {
         return FORMAT_STEREO_IQ;
     } else if (chanOpt == "stereo_qi") {
         return FORMAT_STEREO_QI;
+    } else if (chanOpt == "dual_mono") {
+        return FORMAT_DUAL_MONO;
+    } else if (chanOpt == "multi_mono") {
+        return FORMAT_MULTI_MONO;
+    } else if (chanOpt == "multi_iq") {
+        return FORMAT_MULTI_IQ;
+    } else if (chanOpt == "multi_qi") {
+        return FORMAT_MULTI_QI;
     } else {
         return FORMAT_MONO_L;
     }
 }
 
+std::vector<int> SoapyAudio::deviceIdStrToList(const std::string &deviceIds) {
+    std::vector<int> ids;
+    size_t start = 0;
+    while (start <= deviceIds.size()) {
+        size_t end = deviceIds.find(',', start);
+        if (end == std::string::npos) end = deviceIds.size();
+        try {
+            ids.push_back(std::stoi(deviceIds.substr(start, end - start)));
+        } catch (const std::invalid_argument &) {
+        }
+        start = end + 1;
+    }
+    return ids;
+}
+
+RtAudio::Api SoapyAudio::apiStrToEnum(const std::string &apiName) {
+    RtAudio::Api api = RtAudio::getCompiledApiByName(apiName);
+    if (api == RtAudio::UNSPECIFIED) {
+        std::string compiled;
+        std::vector<RtAudio::Api> apis;
+        RtAudio::getCompiledApi(apis);
+        for (auto a : apis) compiled += (compiled.empty() ? "" : ", ") + RtAudio::getApiName(a);
+        throw std::runtime_error("api '" + apiName + "' is not compiled in, available: " + compiled + ".");
+    }
+    return api;
+}
+
 #ifdef USE_HAMLIB
 void SoapyAudio::checkRigThread() {    
     if (!rigModel || (rigSerialRate < 0) || rigFile == "") {
@@ -24,6 +24,7 @@
 #pragma once
 
 #include <SoapySDR/Device.hpp>
+#include <SoapySDR/Version.h>
 #include <SoapySDR/Logger.h>
 #include <SoapySDR/Types.h>
 #include <RtAudio.h>
@@ -31,10 +32,16 @@
 #include <thread>
 #include <mutex>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <string>
 #include <cstring>
 #include <algorithm>
+#include <cmath>
+#include <memory>
+
+#include "AudioDSP.h"
+#include "AudioRingBuffer.h"
 
 #ifdef USE_HAMLIB
 #include "RigThread.h"
@@ -47,12 +54,54 @@ typedef enum audioStreamFormat
 
 typedef enum chanSetup
 {
-    FORMAT_MONO_L, FORMAT_MONO_R, FORMAT_STEREO_IQ, FORMAT_STEREO_QI
+    FORMAT_MONO_L, FORMAT_MONO_R, FORMAT_STEREO_IQ, FORMAT_STEREO_QI,
+    FORMAT_MULTI_MONO, FORMAT_MULTI_IQ, FORMAT_MULTI_QI, FORMAT_DUAL_MONO
 } chanSetup;
 
 #define DEFAULT_BUFFER_LENGTH 2048
 #define DEFAULT_NUM_BUFFERS 6
 
+//aggregate devices: periods the first card is held back to absorb the
+//other cards' callback jitter, timeline loop bandwidths (wide until the
+//rate estimators settle) and the drift limit
+#define AGGREGATE_DELAY_PERIODS 2
+#define AGGREGATE_SERVO_BANDWIDTH_COARSE 0.5
+#define AGGREGATE_SERVO_BANDWIDTH_FINE 0.05
+#define AGGREGATE_MAX_DRIFT 0.001
+
+class SoapyAudio;
+
+//an additional card of an aggregate device, resampled onto the sample
+//clock of the first card
+struct AudioAggregateCard
+{
+    SoapyAudio *owner;
+    int deviceId;
+    std::unique_ptr<RtAudio> dac;
+    RtAudio::StreamParameters inputParameters;
+    unsigned int bufferLength;
+    float sampleOffsetBuffer[2];
+
+    AudioRateEstimator rateEstimator;
+    std::vector<AudioResampler> resamplers;
+    std::vector<float> convBuff, resampBuff;
+    std::vector<const float *> inputs;
+
+    //first card tick where this card started, and its relative drift
+    std::atomic<double> startTick;
+    std::atomic<double> drift;
+
+    //scheduling and affinity are applied by the card's callback thread
+    std::atomic_bool threadPending;
+
+    //resampled planes waiting for the first card, guarded by mutex
+    std::mutex mutex;
+    std::vector<std::vector<float> > fifos;
+    long long fifoEndTick;
+    double servoRatio, servoElapsed;
+    bool aligned;
+};
+
 class SoapyAudio: public SoapySDR::Device
 {
 public:
@@ -109,6 +158,21 @@ public:
             long long &timeNs,
             const long timeoutUs = 100000);
 
+    int writeStream(
+            SoapySDR::Stream *stream,
+            const void * const *buffs,
+            const size_t numElems,
+            int &flags,
+            const long long timeNs = 0,
+            const long timeoutUs = 100000);
+
+    int readStreamStatus(
+            SoapySDR::Stream *stream,
+            size_t &chanMask,
+            int &flags,
+            long long &timeNs,
+            const long timeoutUs = 100000);
+
     /*******************************************************************
      * Direct buffer access API
      ******************************************************************/
@@ -129,6 +193,19 @@ public:
         SoapySDR::Stream *stream,
         const size_t handle);
 
+    int acquireWriteBuffer(
+        SoapySDR::Stream *stream,
+        size_t &handle,
+        void **buffs,
+        const long timeoutUs = 100000);
+
+    void releaseWriteBuffer(
+        SoapySDR::Stream *stream,
+        const size_t handle,
+        const size_t numElems,
+        int &flags,
+        const long long timeNs = 0);
+
     /*******************************************************************
      * Antenna API
      ******************************************************************/
@@ -194,18 +271,34 @@ public:
 
     std::vector<double> listSampleRates(const int direction, const size_t channel) const;
 
+#ifdef SOAPY_SDR_API_HAS_GET_SAMPLE_RATE_RANGE
+    SoapySDR::RangeList getSampleRateRange(const int direction, const size_t channel) const;
+#endif
+
     void setBandwidth(const int direction, const size_t channel, const double bw);
 
     double getBandwidth(const int direction, const size_t channel) const;
 
     std::vector<double> listBandwidths(const int direction, const size_t channel) const;
 
+    /*******************************************************************
+     * Time API
+     ******************************************************************/
+
+    bool hasHardwareTime(const std::string &what = "") const;
+
+    long long getHardwareTime(const std::string &what = "") const;
+
     /*******************************************************************
      * Utility
      ******************************************************************/
 
     chanSetup chanSetupStrToEnum(std::string chanOpt);
 
+    static std::vector<int> deviceIdStrToList(const std::string &deviceIds);
+
+    static RtAudio::Api apiStrToEnum(const std::string &apiName);
+
     /*******************************************************************
      * Settings API
      ******************************************************************/
@@ -218,44 +311,206 @@ public:
 
 private:
 
-    //device handle
+    //device handle, swapped with the standby handle on rate changes
     int deviceId;
-    RtAudio dac;
+    std::unique_ptr<RtAudio> dac;
+    std::unique_ptr<RtAudio> standbyDac;
     RtAudio::DeviceInfo devInfo;
     RtAudio::StreamOptions opts;
+    RtAudioStreamFlags deviceFlags;
+    bool alsaMmap, alsaPoll;
+    unsigned int periodFrames, periodCount, availMin;
+    std::vector<std::string> jackPorts;
+    bool portBuffers;
+    bool planar;
+    std::vector<const float *> _inputPlanes;
+
+    //capture thread placement and memory locking, the callback thread
+    //applies them to itself and records what it got
+    std::vector<int> cpuAffinity;
+    std::string schedPolicy;
+    int schedPriority;
+    bool lockMemory;
+    std::atomic_bool threadPending;
+    std::atomic<int> threadPolicy, threadPriority;
+    std::atomic_bool threadPinned, memoryLocked;
     RtAudio::StreamParameters inputParameters;
     RtAudio::StreamParameters outputParameters;
 
     //cached settings
     audioStreamFormat asFormat;
     chanSetup cSetup;
-    uint32_t sampleRate, centerFrequency;
+    uint32_t centerFrequency;
+    std::vector<double> bbFrequencies;
     unsigned int bufferLength;
     size_t numBuffers;
     bool agcMode, streamActive;
-    std::atomic_bool sampleRateChanged;
     double audioGain;
     int elementsPerSample;
     int sampleOffset;
     float sampleOffsetBuffer[2];
 
+    //baseband tuning, applied in the rx callback
+    std::atomic_bool ncoChanged;
+
+    //split the device frames into one complex plane per chain, sample i of
+    //device channel c is inputs[c][i * stride] for any buffer layout
+    void convertInput(const float *const *inputs, const size_t stride, const std::vector<size_t> &channels,
+            float *offsetHistory, float *planes, const size_t planeStride, const size_t numFrames);
+
+    //device rate, decimation and resampling needed to produce sampleRate,
+    //the callback and the rate thread publish them while the API reads
+    std::atomic<uint32_t> sampleRate;
+    std::atomic<uint32_t> deviceRate;
+    std::atomic<size_t> decimation;
+    std::atomic<double> resampleRatio;
+    std::vector<AudioRxChain> rxChains;
+    std::vector<float> _convBuff;
+
+    //device clock measured against the host clock
+    AudioRateEstimator rateEstimator;
+    std::atomic<double> measuredRate;
+    std::atomic_bool rateCorrection;
+
+    //filterbank channels, each tuned to the nearest bin plus a residual NCO
+    size_t numChannelizerChannels;
+    AudioChannelizer channelizer;
+    std::vector<double> channelFrequencies;
+    std::vector<size_t> channelBins;
+    std::vector<AudioNCO> channelNCOs;
+    std::atomic_bool channelsChanged;
+    std::vector<float> _wideBuff;
+    std::vector<float> _chanBuff;
+
+    double getChannelFrequency(const size_t channel) const;
+    void updateChannelTuning(void);
+    size_t channelize(const float *iq, const size_t numSamples, std::vector<float> &buff);
+
+    //channels of the active stream, one buffer plane each
+    std::vector<size_t> streamChannels;
+
+    //aggregate device, the first card sets the timeline and its own
+    //planes are delayed so the other cards' queues can catch up
+    std::vector<std::unique_ptr<AudioAggregateCard> > aggregateCards;
+    std::vector<size_t> cardChannels;
+    std::vector<std::vector<float> > _delayBuffs;
+    std::vector<float> _cardBuff;
+    size_t aggregateDelay;
+
+    //first card clock published for the other cards' callbacks
+    std::mutex _clock_mutex;
+    double clockTime, clockRate;
+    long long clockTick;
+    bool clockValid;
+
+    size_t getNumCardChannels(void) const;
+    void gatherAggregate(const float *const *inputs, const size_t stride, const size_t numFrames,
+            const long long tick, float *planes);
+    void pullCard(AudioAggregateCard &card, float *planes, const size_t numFrames, const long long tick);
+
+    //frames delivered by the device since the stream was opened,
+    //on top of the time accumulated at earlier device rates,
+    //the base, ticks and rate change together under _time_mutex
+    std::atomic<long long> deviceTicks;
+    std::atomic<long long> timeBaseNs;
+    mutable std::mutex _time_mutex;
+
+    //rate changes requested while streaming are applied by a control thread,
+    //the ring is kept and the first buffer at the new rate is tagged
+    std::thread rateThread;
+    std::mutex _rate_mutex;
+    std::condition_variable _rate_cond;
+    bool rateThreadExit;
+    std::atomic_bool ratePending;
+    std::atomic_bool rateFailed;
+    bool rateStalled;
+    uint32_t pendingRate, pendingDeviceRate;
+    size_t pendingDecimation;
+    double pendingRatio;
+
+    //chains for a new rate at the same device rate, swapped in by the rx callback
+    std::atomic_bool chainsPending;
+    std::vector<AudioRxChain> nextChains;
+    uint32_t nextRate;
+    size_t nextDecimation;
+    double nextRatio;
+    bool _discontinuity;
+
+    void rateThreadLoop(void);
+    void applyRateChange(std::unique_lock<std::mutex> &lock);
+    void switchDeviceRate(void);
+
+    void selectDeviceRate(const uint32_t rate, const std::vector<unsigned int> &deviceRates,
+            uint32_t &devRate, size_t &decim, double &ratio) const;
+    void adoptDeviceRate(const uint32_t rate);
+    void configureDSP(void);
+    void convertOutput(const float *iq, void *output, const size_t numElems) const;
+
+    //transmit stream on its own output stream, fed through a lock-free ring,
+    //or sharing the input stream and callback in duplex mode
+    bool duplexMode;
+    std::atomic_bool rxActive, txActive;
+    std::unique_ptr<RtAudio> txDac;
+    audioStreamFormat txFormat;
+    chanSetup txSetup;
+    uint32_t txSampleRate;
+    unsigned int txBufferLength;
+    AudioRingBuffer txRing;
+    std::atomic_bool txBurst;
+    std::atomic<size_t> txUnderflows;
+    size_t txUnderflowsLogged, txUnderflowsReported;
+
+    //slot being consumed by the tx callback
+    bool txReading;
+    size_t txReadHandle, txReadOffset, txReadLength;
+
+    //slot being filled by writeStream
+    bool txWriting;
+    size_t txWriteHandle, txWriteOffset;
+
+    bool isTxStream(SoapySDR::Stream *stream) const;
+    RtAudio &txDevice(void);
+    void openDeviceStream(void);
+    void startDeviceStream(void);
+    void closeDeviceStream(RtAudio &device);
+    void configureCaptureThread(const bool primary);
+    std::string captureThreadPolicy(void) const;
+    size_t rxPlaneCapacity(const size_t numFrames) const;
+    void reserveStreamBuffers(void);
+    void reserveSlot(const size_t handle);
+    void lockStreamMemory(const bool lock);
+    SoapySDR::Stream *setupTxStream(const std::vector<size_t> &channels, const SoapySDR::Kwargs &args);
+    void openTxStream(void);
+    void convertTxInput(const void *input, float *iq, const size_t numElems) const;
+    void convertTxOutput(const float *iq, float *output, const size_t numFrames) const;
+
 public:
     //async api usage
     int rx_callback(void *inputBuffer, unsigned int nBufferFrames, double streamTime, RtAudioStreamStatus status);
+    int tx_callback(void *outputBuffer, unsigned int nBufferFrames, double streamTime, RtAudioStreamStatus status);
+    int aggregate_callback(AudioAggregateCard &card, void *inputBuffer, unsigned int nBufferFrames, RtAudioStreamStatus status);
+    int duplex_callback(void *outputBuffer, void *inputBuffer, unsigned int nBufferFrames, double streamTime, RtAudioStreamStatus status);
 
     std::mutex _buf_mutex;
     std::condition_variable _buf_cond;
 
     std::vector<std::vector<float> > _buffs;
+    std::vector<long long> _buffTimes;
+    std::vector<char> _buffDiscontinuity;
+    size_t _buffCapacity;
     size_t	_buf_head;
     size_t	_buf_tail;
     size_t	_buf_count;
-    float *_currentBuff;
+    std::vector<float *> _currentBuffs;
     bool _overflowEvent;
     size_t _currentHandle;
     size_t bufferedElems;
+    size_t _currentElems;
+    long long _currentTimeNs;
     bool resetBuffer;
 
+    std::mutex _tx_mutex;
+    std::condition_variable _tx_cond;
 
 #ifdef USE_HAMLIB
 public:
@@ -27,6 +27,9 @@
 #include <algorithm> //min
 #include <climits> //SHRT_MAX
 #include <cstring> // memcpy
+#ifndef _WIN32
+#include <sys/mman.h> //mlock
+#endif
 
 
 std::vector<std::string> SoapyAudio::getStreamFormats(const int direction, const size_t channel) const {
@@ -40,8 +43,8 @@ std::vector<std::string> SoapyAudio::getStreamFormats(const int direction, const
 }
 
 std::string SoapyAudio::getNativeStreamFormat(const int direction, const size_t channel, double &fullScale) const {
-     fullScale = 65536;
-     return "CS16";
+     fullScale = 1.0;
+     return "CF32";
 }
 
 SoapySDR::ArgInfoList SoapyAudio::getStreamArgsInfo(const int direction, const size_t channel) const {
@@ -49,9 +52,9 @@ SoapySDR::ArgInfoList SoapyAudio::getStreamArgsInfo(const int direction, const s
 
     SoapySDR::ArgInfo chanArg;
     chanArg.key = "chan";
-    chanArg.value = "mono_l";
+    chanArg.value = (direction == SOAPY_SDR_TX) ? "stereo_iq" : "mono_l";
     chanArg.name = "Channel Setup";
-    chanArg.description = "Input channel configuration.";
+    chanArg.description = (direction == SOAPY_SDR_TX) ? "Output channel configuration." : "Input channel configuration.";
     chanArg.type = SoapySDR::ArgInfo::STRING;
     
     std::vector<std::string> chanOpts;
@@ -66,11 +69,144 @@ SoapySDR::ArgInfoList SoapyAudio::getStreamArgsInfo(const int direction, const s
     chanOpts.push_back("stereo_qi");
     chanOptNames.push_back("Complex L/R = Q/I");
 
+    if (direction == SOAPY_SDR_TX)
+    {
+        chanArg.options = chanOpts;
+        chanArg.optionNames = chanOptNames;
+        streamArgs.push_back(chanArg);
+        return streamArgs;
+    }
+
+    chanOpts.push_back("dual_mono");
+    chanOptNames.push_back("Left and Right Real");
+    chanOpts.push_back("multi_mono");
+    chanOptNames.push_back("Each Input Real");
+    chanOpts.push_back("multi_iq");
+    chanOptNames.push_back("Each Input Pair I/Q");
+    chanOpts.push_back("multi_qi");
+    chanOptNames.push_back("Each Input Pair Q/I");
+
     chanArg.options = chanOpts;
     chanArg.optionNames = chanOptNames;
 
     streamArgs.push_back(chanArg);
 
+    SoapySDR::ArgInfo mmapArg;
+    mmapArg.key = "alsa_mmap";
+    mmapArg.value = "false";
+    mmapArg.name = "ALSA mmap Capture";
+    mmapArg.description = "Convert straight out of the ALSA device buffer instead of copying it first.";
+    mmapArg.type = SoapySDR::ArgInfo::BOOL;
+
+    streamArgs.push_back(mmapArg);
+
+    SoapySDR::ArgInfo pollArg;
+    pollArg.key = "alsa_poll";
+    pollArg.value = "false";
+    pollArg.name = "ALSA Poll Capture";
+    pollArg.description = "Wake on the device poll descriptors and deliver whatever is available, buffers vary in size.";
+    pollArg.type = SoapySDR::ArgInfo::BOOL;
+
+    streamArgs.push_back(pollArg);
+
+    SoapySDR::ArgInfo periodFramesArg;
+    periodFramesArg.key = "period_frames";
+    periodFramesArg.value = "0";
+    periodFramesArg.name = "Period Frames";
+    periodFramesArg.description = "Frames per device period, 0 uses the channel setup default.";
+    periodFramesArg.units = "frames";
+    periodFramesArg.type = SoapySDR::ArgInfo::INT;
+
+    streamArgs.push_back(periodFramesArg);
+
+    SoapySDR::ArgInfo periodsArg;
+    periodsArg.key = "periods";
+    periodsArg.value = "0";
+    periodsArg.name = "Periods";
+    periodsArg.description = "Periods in the device buffer, 0 uses the backend default (ALSA, PulseAudio, OSS, DirectSound).";
+    periodsArg.type = SoapySDR::ArgInfo::INT;
+
+    streamArgs.push_back(periodsArg);
+
+    SoapySDR::ArgInfo availMinArg;
+    availMinArg.key = "avail_min";
+    availMinArg.value = "0";
+    availMinArg.name = "ALSA avail_min";
+    availMinArg.description = "Frames available before the capture wakes up, 0 uses the driver default.";
+    availMinArg.units = "frames";
+    availMinArg.type = SoapySDR::ArgInfo::INT;
+
+    streamArgs.push_back(availMinArg);
+
+    SoapySDR::ArgInfo jackPortsArg;
+    jackPortsArg.key = "jack_ports";
+    jackPortsArg.value = "";
+    jackPortsArg.name = "JACK Ports";
+    jackPortsArg.description = "Comma separated JACK output ports to capture, one per input channel, instead of the device's own.";
+    jackPortsArg.type = SoapySDR::ArgInfo::STRING;
+
+    streamArgs.push_back(jackPortsArg);
+
+    SoapySDR::ArgInfo planarArg;
+    planarArg.key = "planar";
+    planarArg.value = "false";
+    planarArg.name = "Planar Capture";
+    planarArg.description = "Capture one contiguous buffer per device channel, not available in duplex or aggregate mode.";
+    planarArg.type = SoapySDR::ArgInfo::BOOL;
+
+    streamArgs.push_back(planarArg);
+
+    SoapySDR::ArgInfo affinityArg;
+    affinityArg.key = "cpu_affinity";
+    affinityArg.value = "";
+    affinityArg.name = "Capture CPU Affinity";
+    affinityArg.description = "Comma separated CPUs the capture threads are pinned to, empty leaves them unpinned (Linux only).";
+    affinityArg.type = SoapySDR::ArgInfo::STRING;
+
+    streamArgs.push_back(affinityArg);
+
+    SoapySDR::ArgInfo policyArg;
+    policyArg.key = "sched_policy";
+    policyArg.value = "";
+    policyArg.name = "Capture Scheduling";
+    policyArg.description = "Scheduling class of the capture threads, empty keeps the backend's choice.";
+    policyArg.type = SoapySDR::ArgInfo::STRING;
+
+    std::vector<std::string> policyOpts;
+    std::vector<std::string> policyOptNames;
+
+    policyOpts.push_back("");
+    policyOptNames.push_back("Backend Default");
+    policyOpts.push_back("fifo");
+    policyOptNames.push_back("SCHED_FIFO");
+    policyOpts.push_back("rr");
+    policyOptNames.push_back("SCHED_RR");
+    policyOpts.push_back("other");
+    policyOptNames.push_back("SCHED_OTHER");
+
+    policyArg.options = policyOpts;
+    policyArg.optionNames = policyOptNames;
+
+    streamArgs.push_back(policyArg);
+
+    SoapySDR::ArgInfo priorityArg;
+    priorityArg.key = "sched_priority";
+    priorityArg.value = "0";
+    priorityArg.name = "Capture Priority";
+    priorityArg.description = "Realtime priority of the capture threads, 0 uses the highest one.";
+    priorityArg.type = SoapySDR::ArgInfo::INT;
+
+    streamArgs.push_back(priorityArg);
+
+    SoapySDR::ArgInfo mlockArg;
+    mlockArg.key = "mlock";
+    mlockArg.value = "false";
+    mlockArg.name = "Lock Buffers";
+    mlockArg.description = "Lock the sample ring and the device buffers into memory.";
+    mlockArg.type = SoapySDR::ArgInfo::BOOL;
+
+    streamArgs.push_back(mlockArg);
+
     return streamArgs;
 }
 
@@ -87,29 +223,293 @@ static int _rx_callback(void *outputBuffer, void *inputBuffer, unsigned int nBuf
     return self->rx_callback(inputBuffer, nBufferFrames, streamTime, status);
 }
 
+static int _tx_callback(void *outputBuffer, void *inputBuffer, unsigned int nBufferFrames, double streamTime, RtAudioStreamStatus status,
+        void *ctx)
+{
+    SoapyAudio *self = (SoapyAudio *)ctx;
+    return self->tx_callback(outputBuffer, nBufferFrames, streamTime, status);
+}
+
+static int _aggregate_callback(void *outputBuffer, void *inputBuffer, unsigned int nBufferFrames, double streamTime, RtAudioStreamStatus status,
+        void *ctx)
+{
+    AudioAggregateCard *card = (AudioAggregateCard *)ctx;
+    return card->owner->aggregate_callback(*card, inputBuffer, nBufferFrames, status);
+}
+
+static int _duplex_callback(void *outputBuffer, void *inputBuffer, unsigned int nBufferFrames, double streamTime, RtAudioStreamStatus status,
+        void *ctx)
+{
+    SoapyAudio *self = (SoapyAudio *)ctx;
+    return self->duplex_callback(outputBuffer, inputBuffer, nBufferFrames, streamTime, status);
+}
+
+//the NCO and the filters can overshoot full scale, integer
+//conversions saturate instead of wrapping, NaN ends up on a rail
+static inline float clampSample(const float x)
+{
+    return std::max(-1.0f, std::min(x, 1.0f));
+}
+
+//pins or releases the whole capacity of each vector
+static bool lockBuffers(const std::vector<std::vector<float> *> &buffers, const bool lock)
+{
+    bool locked = true;
+#ifndef _WIN32
+    for (auto buff : buffers)
+    {
+        if (buff->capacity() == 0) continue;
+        if (lock) locked = (mlock(buff->data(), buff->capacity() * sizeof(float)) == 0) && locked;
+        else munlock(buff->data(), buff->capacity() * sizeof(float));
+    }
+#else
+    locked = false;
+#endif
+    return locked;
+}
+
+//per channel base pointers into a device buffer, one period apart when
+//non-interleaved, returns the distance between frames of one channel
+static size_t mapInputChannels(const void *inputBuffer, const bool planar, const size_t periodFrames,
+        std::vector<const float *> &inputs)
+{
+    const float *input = (const float *) inputBuffer;
+    for (size_t c = 0; c < inputs.size(); c++)
+    {
+        inputs[c] = planar ? input + c * periodFrames : input + c;
+    }
+    return planar ? 1 : inputs.size();
+}
+
+void SoapyAudio::convertInput(const float *const *inputs, const size_t stride, const std::vector<size_t> &channels,
+        float *offsetHistory, float *planes, const size_t planeStride, const size_t numFrames)
+{
+    if (cSetup == FORMAT_MULTI_MONO || cSetup == FORMAT_DUAL_MONO)
+    {
+        //one real plane per streamed input
+        for (size_t p = 0; p < channels.size(); p++)
+        {
+            const float *in = inputs[channels[p]];
+            float *iq = planes + p * planeStride * 2;
+            for (size_t i = 0; i < numFrames; i++)
+            {
+                iq[i * 2] = in[i * stride];
+                iq[i * 2 + 1] = 0;
+            }
+        }
+        return;
+    }
+
+    if (cSetup == FORMAT_MULTI_IQ || cSetup == FORMAT_MULTI_QI)
+    {
+        const size_t swap = (cSetup == FORMAT_MULTI_QI) ? 1 : 0;
+        for (size_t p = 0; p < channels.size(); p++)
+        {
+            const float *inI = inputs[channels[p] * 2 + swap];
+            const float *inQ = inputs[channels[p] * 2 + 1 - swap];
+            float *iq = planes + p * planeStride * 2;
+            for (size_t i = 0; i < numFrames; i++)
+            {
+                iq[i * 2] = inI[i * stride];
+                iq[i * 2 + 1] = inQ[i * stride];
+            }
+        }
+        return;
+    }
+
+    float *iq = planes;
+
+    if (elementsPerSample == 1)
+    {
+        for (size_t i = 0; i < numFrames; i++)
+        {
+            iq[i * 2] = inputs[0][i * stride];
+            iq[i * 2 + 1] = 0;
+        }
+        return;
+    }
+
+    //stereo input: L/R map to I/Q or Q/I
+    const size_t iIdx = (cSetup == FORMAT_STEREO_QI) ? 1 : 0;
+    const size_t qIdx = 1 - iIdx;
+
+    for (size_t i = 0; i < numFrames; i++)
+    {
+        iq[i * 2] = inputs[iIdx][i * stride];
+        iq[i * 2 + 1] = inputs[qIdx][i * stride];
+    }
+
+    if (!sampleOffset) return;
+
+    //delay the left (positive offset) or right (negative offset) input
+    //by the given number of samples, carrying history between buffers
+    const size_t delay = std::min<size_t>(std::abs(sampleOffset), numFrames);
+    const size_t delayIdx = (sampleOffset > 0) ? iIdx : qIdx;
+    const float *delayed = inputs[(sampleOffset > 0) ? 0 : 1];
+
+    for (size_t i = numFrames; i-- > delay;)
+    {
+        iq[i * 2 + delayIdx] = delayed[(i - delay) * stride];
+    }
+    for (size_t i = 0; i < delay; i++)
+    {
+        iq[i * 2 + delayIdx] = offsetHistory[i];
+    }
+    for (size_t i = 0; i < delay; i++)
+    {
+        offsetHistory[i] = delayed[(numFrames - delay + i) * stride];
+    }
+}
+
 int SoapyAudio::rx_callback(void *inputBuffer, unsigned int nBufferFrames, double streamTime, RtAudioStreamStatus status)
 {
-    std::unique_lock<std::mutex> lock(_buf_mutex);
+    //the first period of a newly opened stream places its thread
+    if (threadPending.exchange(false)) configureCaptureThread(true);
+
+    //arrival time of this period for the device rate estimate
+    const double now = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (status & RTAUDIO_INPUT_OVERFLOW) rateEstimator.resync();
+    rateEstimator.update(now, nBufferFrames);
+    measuredRate.store(rateEstimator.getRate());
 
-    if (sampleRateChanged.load()) {
-        return 1;
+    //device frame count of this period, held back by the alignment delay when aggregating
+    const bool aggregating = !aggregateCards.empty();
+    const long long tick = deviceTicks.fetch_add(nBufferFrames) - (long long) aggregateDelay;
+
+    //jack hands its port buffers over as they are, otherwise every channel
+    //is addressed from the start of the period
+    const float *const *inputs = (const float *const *) inputBuffer;
+    size_t inputStride = 1;
+    if (!portBuffers)
+    {
+        inputStride = mapInputChannels(inputBuffer, planar, bufferLength, _inputPlanes);
+        inputs = _inputPlanes.data();
     }
 
-    //printf("_rx_callback %d _buf_head=%d, numBuffers=%d\n", len, _buf_head, _buf_tail);
+    if (aggregating)
+    {
+        std::unique_lock<std::mutex> lock(_clock_mutex);
+        clockTime = now;
+        clockRate = rateEstimator.getRate();
+        clockTick = tick + (long long) aggregateDelay + nBufferFrames;
+        clockValid = true;
+    }
 
-    //overflow condition: the caller is not reading fast enough
-    if (_buf_count == numBuffers)
     {
-        _overflowEvent = true;
-        return 0;
+        std::unique_lock<std::mutex> lock(_buf_mutex);
+
+        //printf("_rx_callback %d _buf_head=%d, numBuffers=%d\n", len, _buf_head, _buf_tail);
+
+        //overflow condition: the caller is not reading fast enough
+        if (_buf_count == numBuffers)
+        {
+            _overflowEvent = true;
+            lock.unlock();
+
+            //the other cards' queues still advance with the timeline
+            if (aggregating) gatherAggregate(inputs, inputStride, nBufferFrames, tick, nullptr);
+            return 0;
+        }
     }
 
-    //copy into the buffer queue
+    //a new rate at the same device rate takes effect on a period boundary
+    if (chainsPending.load())
+    {
+        rxChains.swap(nextChains);
+        sampleRate = nextRate;
+        decimation = nextDecimation;
+        resampleRatio = nextRatio;
+        ncoChanged.store(true);
+        channelsChanged.store(true);
+        _discontinuity = true;
+        chainsPending.store(false);
+    }
+
+    //the tail buffer is owned by the callback until it is counted,
+    //so conversion and mixing happen without holding the lock
     auto &buff = _buffs[_buf_tail];
-    buff.resize(nBufferFrames * elementsPerSample);
-    std::memcpy(buff.data(), inputBuffer, nBufferFrames * elementsPerSample * sizeof(float));
+
+    const bool channelizing = (numChannelizerChannels > 0);
+    const bool correcting = rateCorrection.load();
+    const bool resampling = (resampleRatio != 1.0 || correcting);
+    const size_t numPlanes = rxChains.size();
+
+    if (ncoChanged.exchange(false))
+    {
+        for (size_t p = 0; p < numPlanes; p++)
+        {
+            rxChains[p].nco.setFrequency(channelizing ? 0.0 : bbFrequencies[streamChannels[p]], deviceRate);
+        }
+    }
+
+    bool mixing = false;
+    for (auto &chain : rxChains) mixing = mixing || chain.nco.isEnabled();
+
+    size_t numOut = nBufferFrames;
+
+    if (decimation == 1 && !resampling && !channelizing && !mixing && !aggregating)
+    {
+        //nothing to filter, deinterleave straight into the queued buffer
+        buff.resize(numPlanes * nBufferFrames * 2);
+        convertInput(inputs, inputStride, streamChannels, sampleOffsetBuffer, buff.data(), nBufferFrames, nBufferFrames);
+    }
+    else
+    {
+        //rate conversion starts at the device rate in scratch space
+        if (aggregating)
+        {
+            gatherAggregate(inputs, inputStride, nBufferFrames, tick, _convBuff.data());
+        }
+        else
+        {
+            convertInput(inputs, inputStride, streamChannels, sampleOffsetBuffer, _convBuff.data(), nBufferFrames, nBufferFrames);
+        }
+
+        for (auto &chain : rxChains)
+        {
+            if (correcting && rateEstimator.isSettled())
+            {
+                chain.resampler.setRatio(resampleRatio * deviceRate / rateEstimator.getRate());
+            }
+            else if (!correcting && chain.resampler.getRatio() != resampleRatio)
+            {
+                chain.resampler.setRatio(resampleRatio);
+            }
+        }
+
+        //every chain shares a configuration, so all produce the same count
+        const size_t planeStride = rxChains[0].maxOutput(nBufferFrames, resampling);
+        std::vector<float> &out = channelizing ? _wideBuff : buff;
+        out.resize(numPlanes * planeStride * 2);
+
+        for (size_t p = 0; p < numPlanes; p++)
+        {
+            numOut = rxChains[p].process(_convBuff.data() + p * nBufferFrames * 2, nBufferFrames, resampling, out.data() + p * planeStride * 2);
+        }
+
+        //close the gaps between planes
+        for (size_t p = 1; p < numPlanes && numOut < planeStride; p++)
+        {
+            std::memmove(out.data() + p * numOut * 2, out.data() + p * planeStride * 2, numOut * 2 * sizeof(float));
+        }
+
+        if (channelizing)
+        {
+            numOut = channelize(_wideBuff.data(), numOut, buff);
+        }
+        else
+        {
+            buff.resize(numPlanes * numOut * 2);
+        }
+    }
+    if (numOut == 0) return 0;
+
+    std::unique_lock<std::mutex> lock(_buf_mutex);
 
     //increment the tail pointer
+    _buffTimes[_buf_tail] = timeBaseNs + (long long)(tick * (1e9 / deviceRate));
+    _buffDiscontinuity[_buf_tail] = _discontinuity;
+    _discontinuity = false;
     _buf_tail = (_buf_tail + 1) % numBuffers;
     _buf_count++;
 
@@ -119,6 +519,218 @@ int SoapyAudio::rx_callback(void *inputBuffer, unsigned int nBufferFrames, doubl
     return 0;
 }
 
+int SoapyAudio::duplex_callback(void *outputBuffer, void *inputBuffer, unsigned int nBufferFrames, double streamTime, RtAudioStreamStatus status)
+{
+    if (threadPending.exchange(false)) configureCaptureThread(true);
+
+    //both rings are serviced in the same period, so the round trip
+    //through the device is a fixed number of periods
+    if (txActive.load())
+    {
+        tx_callback(outputBuffer, nBufferFrames, streamTime, status);
+    }
+    else
+    {
+        std::memset(outputBuffer, 0, nBufferFrames * outputParameters.nChannels * sizeof(float));
+    }
+
+    if (!rxActive.load()) return 0;
+    return rx_callback(inputBuffer, nBufferFrames, streamTime, status);
+}
+
+void SoapyAudio::updateChannelTuning(void)
+{
+    //bins are spaced by the per-channel rate, the NCO covers the remainder
+    const double spacing = sampleRate;
+    for (size_t k = 0; k < numChannelizerChannels; k++)
+    {
+        const double freq = getChannelFrequency(k);
+        const long bin = std::lround(freq / spacing);
+        channelBins[k] = size_t(((bin % long(numChannelizerChannels)) + long(numChannelizerChannels)) % long(numChannelizerChannels));
+        channelNCOs[k].setFrequency(freq - bin * spacing, sampleRate);
+    }
+}
+
+size_t SoapyAudio::channelize(const float *iq, const size_t numSamples, std::vector<float> &buff)
+{
+    if (channelsChanged.exchange(false))
+    {
+        updateChannelTuning();
+    }
+
+    //one transform yields every bin, only the streamed ones are kept
+    const size_t planeStride = channelizer.maxOutput(numSamples);
+    _chanBuff.resize(planeStride * 2 * numChannelizerChannels);
+    const size_t count = channelizer.process(iq, numSamples, _chanBuff.data(), planeStride);
+
+    buff.resize(count * 2 * streamChannels.size());
+    for (size_t i = 0; i < streamChannels.size(); i++)
+    {
+        const size_t k = streamChannels[i];
+        float *plane = buff.data() + i * count * 2;
+        std::memcpy(plane, _chanBuff.data() + channelBins[k] * planeStride * 2, count * 2 * sizeof(float));
+        if (channelNCOs[k].isEnabled())
+        {
+            channelNCOs[k].mix(plane, count);
+        }
+    }
+
+    return count;
+}
+
+void SoapyAudio::gatherAggregate(const float *const *inputs, const size_t stride, const size_t numFrames,
+        const long long tick, float *planes)
+{
+    const size_t perCard = cardChannels.size();
+    const size_t cardPlanes = perCard * numFrames * 2;
+    _cardBuff.resize(cardPlanes * (aggregateCards.size() + 1));
+
+    convertInput(inputs, stride, cardChannels, sampleOffsetBuffer, _cardBuff.data(), numFrames, numFrames);
+
+    //the first card's planes come out of the alignment delay
+    for (size_t j = 0; j < perCard; j++)
+    {
+        float *plane = _cardBuff.data() + j * numFrames * 2;
+        auto &delay = _delayBuffs[j];
+        delay.insert(delay.end(), plane, plane + numFrames * 2);
+        std::copy(delay.begin(), delay.begin() + numFrames * 2, plane);
+        delay.erase(delay.begin(), delay.begin() + numFrames * 2);
+    }
+
+    //the other cards are taken from their queues at the same ticks
+    for (size_t k = 0; k < aggregateCards.size(); k++)
+    {
+        pullCard(*aggregateCards[k], _cardBuff.data() + (k + 1) * cardPlanes, numFrames, tick);
+    }
+
+    if (planes == nullptr) return;
+
+    //channel numbers index the card planes directly
+    for (size_t p = 0; p < streamChannels.size(); p++)
+    {
+        std::memcpy(planes + p * numFrames * 2, _cardBuff.data() + streamChannels[p] * numFrames * 2, numFrames * 2 * sizeof(float));
+    }
+}
+
+void SoapyAudio::pullCard(AudioAggregateCard &card, float *planes, const size_t numFrames, const long long tick)
+{
+    const size_t perCard = cardChannels.size();
+    std::fill(planes, planes + perCard * numFrames * 2, 0.0f);
+
+    std::unique_lock<std::mutex> lock(card.mutex);
+    if (!card.aligned) return;
+
+    //samples behind this period are dropped, a late queue leaves leading zeros
+    const size_t fill = card.fifos[0].size() / 2;
+    const long long startTick = card.fifoEndTick - (long long) fill;
+    const size_t drop = (size_t) std::min<long long>(std::max<long long>(tick - startTick, 0), fill);
+    const size_t pad = (size_t) std::min<long long>(std::max<long long>(startTick - tick, 0), numFrames);
+    const size_t count = std::min(fill - drop, numFrames - pad);
+
+    for (size_t j = 0; j < perCard; j++)
+    {
+        auto &fifo = card.fifos[j];
+        std::copy(fifo.begin() + drop * 2, fifo.begin() + (drop + count) * 2, planes + j * numFrames * 2 + pad * 2);
+        fifo.erase(fifo.begin(), fifo.begin() + (drop + count) * 2);
+    }
+}
+
+int SoapyAudio::aggregate_callback(AudioAggregateCard &card, void *inputBuffer, unsigned int nBufferFrames, RtAudioStreamStatus status)
+{
+    if (card.threadPending.exchange(false)) configureCaptureThread(false);
+
+    const double now = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (status & RTAUDIO_INPUT_OVERFLOW) card.rateEstimator.resync();
+    card.rateEstimator.update(now, nBufferFrames);
+
+    double masterTime, masterRate;
+    long long masterTick;
+    {
+        std::unique_lock<std::mutex> lock(_clock_mutex);
+        if (!clockValid) return 0;
+        masterTime = clockTime;
+        masterRate = clockRate;
+        masterTick = clockTick;
+    }
+
+    //first card tick following the last frame of this period, less the
+    //group delay of the resampler, arrival jitter is left to the loop
+    const double endTick = masterTick + (now - masterTime) * masterRate
+            - AUDIO_RESAMP_TAPS_PER_PHASE / 2.0;
+
+    double ratio = 1.0;
+    {
+        std::unique_lock<std::mutex> lock(card.mutex);
+
+        if (card.aligned)
+        {
+            //second order loop pulls the queue end onto the expected tick,
+            //its integrator follows the drift between the two clocks
+            const double err = endTick - (card.fifoEndTick + nBufferFrames * card.servoRatio);
+            const double period = nBufferFrames / masterRate;
+            const double bw = (card.servoElapsed < AUDIO_DLL_COARSE_SECONDS) ? AGGREGATE_SERVO_BANDWIDTH_COARSE : AGGREGATE_SERVO_BANDWIDTH_FINE;
+            const double omega = 2.0 * M_PI * bw * period;
+
+            //a stall on either side is realigned rather than slewed
+            const size_t fill = card.fifos[0].size() / 2;
+            if (std::abs(err) > nBufferFrames || fill > 2 * (aggregateDelay + nBufferFrames))
+            {
+                card.aligned = false;
+            }
+            else
+            {
+                //late callbacks should not yank the loop, clip the error to a fraction of a period
+                const double clipped = std::min(std::max(err, -0.125 * nBufferFrames), 0.125 * nBufferFrames);
+                card.servoRatio += omega * omega * clipped / nBufferFrames;
+                card.servoRatio = std::min(std::max(card.servoRatio, 1.0 - AGGREGATE_MAX_DRIFT), 1.0 + AGGREGATE_MAX_DRIFT);
+                card.servoElapsed += period;
+                ratio = card.servoRatio + std::sqrt(2.0) * omega * clipped / nBufferFrames;
+                card.drift.store((1.0 / card.servoRatio - 1.0) * 1e6);
+            }
+        }
+
+        if (!card.aligned)
+        {
+            card.servoRatio = 1.0;
+            card.servoElapsed = 0;
+            for (auto &fifo : card.fifos) fifo.clear();
+            for (auto &resampler : card.resamplers) resampler.reset();
+        }
+    }
+
+    const size_t perCard = cardChannels.size();
+    const size_t stride = mapInputChannels(inputBuffer, false, nBufferFrames, card.inputs);
+    convertInput(card.inputs.data(), stride, cardChannels, card.sampleOffsetBuffer, card.convBuff.data(), nBufferFrames, nBufferFrames);
+
+    for (auto &resampler : card.resamplers) resampler.setRatio(ratio);
+
+    size_t numOut = 0;
+    const size_t planeStride = card.resamplers[0].maxOutput(nBufferFrames);
+    card.resampBuff.resize(perCard * planeStride * 2);
+    for (size_t j = 0; j < perCard; j++)
+    {
+        numOut = card.resamplers[j].process(card.convBuff.data() + j * nBufferFrames * 2, nBufferFrames, card.resampBuff.data() + j * planeStride * 2);
+    }
+
+    std::unique_lock<std::mutex> lock(card.mutex);
+
+    if (!card.aligned)
+    {
+        card.fifoEndTick = std::llround(endTick) - (long long) numOut;
+        card.startTick.store(endTick - numOut);
+        card.aligned = true;
+    }
+
+    for (size_t j = 0; j < perCard; j++)
+    {
+        const float *plane = card.resampBuff.data() + j * planeStride * 2;
+        card.fifos[j].insert(card.fifos[j].end(), plane, plane + numOut * 2);
+    }
+    card.fifoEndTick += numOut;
+
+    return 0;
+}
+
 /*******************************************************************
  * Stream API
  ******************************************************************/
@@ -129,26 +741,22 @@ SoapySDR::Stream *SoapyAudio::setupStream(
         const std::vector<size_t> &channels,
         const SoapySDR::Kwargs &args)
 {
-    //check the channel configuration
-    if (channels.size() > 1 or (channels.size() > 0 and channels.at(0) != 0))
-    {
-        throw std::runtime_error("setupStream invalid channel selection");
-    }
 
     //check the format
+    audioStreamFormat streamFormat;
     if (format == "CF32")
     {
         SoapySDR_log(SOAPY_SDR_INFO, "Using format CF32.");
-        asFormat = AUDIO_FORMAT_FLOAT32;
+        streamFormat = AUDIO_FORMAT_FLOAT32;
     }
     else if (format == "CS16")
     {
         SoapySDR_log(SOAPY_SDR_INFO, "Using format CS16.");
-        asFormat = AUDIO_FORMAT_INT16;
+        streamFormat = AUDIO_FORMAT_INT16;
     }
     else if (format == "CS8") {
         SoapySDR_log(SOAPY_SDR_INFO, "Using format CS8.");
-        asFormat = AUDIO_FORMAT_INT8;
+        streamFormat = AUDIO_FORMAT_INT8;
     }
     else
     {
@@ -157,14 +765,127 @@ SoapySDR::Stream *SoapyAudio::setupStream(
                         + "' -- Only CS8, CS16 and CF32 are supported by SoapyAudio module.");
     }
 
+    if (direction == SOAPY_SDR_TX)
+    {
+        txFormat = streamFormat;
+        return setupTxStream(channels, args);
+    }
+    else if (direction != SOAPY_SDR_RX)
+    {
+        throw std::runtime_error("setupStream invalid direction");
+    }
+    asFormat = streamFormat;
+
     if (args.count("chan") != 0)
     {
         std::string chanOpt = args.at("chan");        
         cSetup = chanSetupStrToEnum(chanOpt);
-    } else {
-        cSetup = FORMAT_MONO_L;
     }
 
+    alsaMmap = false;
+    if (args.count("alsa_mmap") != 0)
+    {
+        alsaMmap = (args.at("alsa_mmap") == "true");
+#ifndef RTAUDIO_SOAPY_EXTENSIONS
+        if (alsaMmap) SoapySDR_log(SOAPY_SDR_WARNING, "alsa_mmap needs the bundled RtAudio, ignored.");
+#endif
+    }
+
+    alsaPoll = false;
+    if (args.count("alsa_poll") != 0)
+    {
+        alsaPoll = (args.at("alsa_poll") == "true");
+#ifndef RTAUDIO_SOAPY_EXTENSIONS
+        if (alsaPoll) SoapySDR_log(SOAPY_SDR_WARNING, "alsa_poll needs the bundled RtAudio, ignored.");
+#endif
+    }
+
+    //buffer geometry, the device may round any of these
+    periodFrames = (args.count("period_frames") != 0) ? std::stoul(args.at("period_frames")) : 0;
+    periodCount = (args.count("periods") != 0) ? std::stoul(args.at("periods")) : 0;
+    availMin = (args.count("avail_min") != 0) ? std::stoul(args.at("avail_min")) : 0;
+#ifndef RTAUDIO_SOAPY_EXTENSIONS
+    if (availMin != 0) SoapySDR_log(SOAPY_SDR_WARNING, "avail_min needs the bundled RtAudio, ignored.");
+#endif
+
+    jackPorts.clear();
+    if (args.count("jack_ports") != 0)
+    {
+        const std::string &ports = args.at("jack_ports");
+        size_t start = 0;
+        while (start < ports.size())
+        {
+            size_t end = ports.find(',', start);
+            if (end == std::string::npos) end = ports.size();
+            if (end > start) jackPorts.push_back(ports.substr(start, end - start));
+            start = end + 1;
+        }
+#ifndef RTAUDIO_SOAPY_EXTENSIONS
+        if (!jackPorts.empty()) SoapySDR_log(SOAPY_SDR_WARNING, "jack_ports needs the bundled RtAudio, ignored.");
+#endif
+    }
+
+    //the layout flag applies to both directions and to every card of a stream
+    planar = false;
+    if (args.count("planar") != 0)
+    {
+        planar = (args.at("planar") == "true");
+        if (planar && (duplexMode || !aggregateCards.empty()))
+        {
+            SoapySDR_log(SOAPY_SDR_WARNING, "planar is not available in duplex or aggregate mode, ignored.");
+            planar = false;
+        }
+    }
+
+    //capture thread placement, the backend's defaults unless asked for
+    cpuAffinity.clear();
+    if (args.count("cpu_affinity") != 0)
+    {
+        const std::string &cpus = args.at("cpu_affinity");
+        size_t start = 0;
+        while (start < cpus.size())
+        {
+            size_t end = cpus.find(',', start);
+            if (end == std::string::npos) end = cpus.size();
+            if (end > start) cpuAffinity.push_back(std::stoi(cpus.substr(start, end - start)));
+            start = end + 1;
+        }
+#ifndef __linux__
+        if (!cpuAffinity.empty()) SoapySDR_log(SOAPY_SDR_WARNING, "cpu_affinity is only supported on Linux, ignored.");
+#endif
+    }
+
+    schedPolicy = (args.count("sched_policy") != 0) ? args.at("sched_policy") : "";
+    if (!schedPolicy.empty() && schedPolicy != "fifo" && schedPolicy != "rr" && schedPolicy != "other")
+    {
+        throw std::runtime_error("setupStream invalid sched_policy '" + schedPolicy + "' -- Only fifo, rr and other are supported.");
+    }
+    schedPriority = (args.count("sched_priority") != 0) ? std::stoi(args.at("sched_priority")) : 0;
+
+    lockMemory = false;
+    if (args.count("mlock") != 0)
+    {
+        lockMemory = (args.at("mlock") == "true");
+#ifndef RTAUDIO_SOAPY_EXTENSIONS
+        if (lockMemory) SoapySDR_log(SOAPY_SDR_WARNING, "mlock needs the bundled RtAudio for the device buffers, only the ring is locked.");
+#endif
+    }
+
+    //check the channel configuration
+    streamChannels = channels.empty() ? std::vector<size_t>(1, 0) : channels;
+    for (auto chan : streamChannels)
+    {
+        if (chan >= getNumChannels(direction))
+        {
+            throw std::runtime_error("setupStream invalid channel selection");
+        }
+    }
+    _currentBuffs.resize(streamChannels.size());
+
+    //every channel of a card is captured when aggregating
+    cardChannels.resize(getNumCardChannels());
+    for (size_t j = 0; j < cardChannels.size(); j++) cardChannels[j] = j;
+
     inputParameters.deviceId = deviceId;
     
     switch (cSetup) {
@@ -192,29 +913,540 @@ SoapySDR::Stream *SoapyAudio::setupStream(
             bufferLength = DEFAULT_BUFFER_LENGTH*2;
             elementsPerSample = 2;
             break;
+        case FORMAT_DUAL_MONO:
+            inputParameters.nChannels = 2;
+            inputParameters.firstChannel = 0;
+            bufferLength = DEFAULT_BUFFER_LENGTH;
+            elementsPerSample = 2;
+            break;
+        case FORMAT_MULTI_MONO:
+            inputParameters.nChannels = std::max<unsigned int>(devInfo.inputChannels, 1);
+            inputParameters.firstChannel = 0;
+            bufferLength = DEFAULT_BUFFER_LENGTH;
+            elementsPerSample = inputParameters.nChannels;
+            break;
+        case FORMAT_MULTI_IQ:
+        case FORMAT_MULTI_QI:
+            inputParameters.nChannels = std::max<unsigned int>(devInfo.inputChannels & ~1u, 2);
+            inputParameters.firstChannel = 0;
+            bufferLength = DEFAULT_BUFFER_LENGTH;
+            elementsPerSample = inputParameters.nChannels;
+            break;
+    }
+
+    if (periodFrames != 0) bufferLength = periodFrames;
+    _inputPlanes.resize(inputParameters.nChannels);
+
+    //one conversion chain per streamed input, the channelizer has a single wideband one
+    rxChains.resize(numChannelizerChannels ? 1 : streamChannels.size());
+
+    //clear async fifo counts
+    _buf_tail = 0;
+    _buf_count = 0;
+    _buf_head = 0;
+
+    //allocate buffers, each holds a plane of interleaved complex samples per channel
+    _buffs.resize(numBuffers);
+    _buffTimes.assign(numBuffers, 0);
+    _buffDiscontinuity.assign(numBuffers, 0);
+    for (auto &buff : _buffs) buff.reserve(bufferLength * 2 * streamChannels.size());
+    for (auto &buff : _buffs) buff.resize(bufferLength * 2);
+
+    return (SoapySDR::Stream *) this;
+}
+
+void SoapyAudio::closeStream(SoapySDR::Stream *stream)
+{
+    if (isTxStream(stream))
+    {
+        txRing.configure(0, 0);
+        return;
+    }
+    if (lockMemory) lockStreamMemory(false);
+    _buffs.clear();
+}
+
+size_t SoapyAudio::getStreamMTU(SoapySDR::Stream *stream) const
+{
+    if (isTxStream(stream)) return txBufferLength;
+    return bufferLength;
+}
+
+void SoapyAudio::configureDSP(void)
+{
+    //the filter state is replaced, the new one is locked with the next start
+    if (lockMemory) lockStreamMemory(false);
+    ncoChanged.store(true);
+    for (auto &chain : rxChains) chain.configure(decimation, resampleRatio);
+    rateEstimator.reset(deviceRate);
+    if (numChannelizerChannels)
+    {
+        channelizer.configure(numChannelizerChannels);
+        for (auto &chanNCO : channelNCOs) chanNCO.reset();
+        channelsChanged.store(true);
+    }
+}
+
+void SoapyAudio::rateThreadLoop(void)
+{
+    std::unique_lock<std::mutex> lock(_rate_mutex);
+    while (!rateThreadExit)
+    {
+        if (ratePending.load())
+        {
+            applyRateChange(lock);
+            continue;
+        }
+        _rate_cond.wait(lock);
+    }
+}
+
+void SoapyAudio::applyRateChange(std::unique_lock<std::mutex> &lock)
+{
+    //the callback may still own the chains of a previous change
+    for (int i = 0; i < 1000 && chainsPending.load() && rxActive.load(); i++)
+    {
+        _rate_cond.wait_for(lock, std::chrono::milliseconds(1));
+    }
+
+    rateStalled = false;
+    if (!rxActive.load())
+    {
+        sampleRate = pendingRate;
+        {
+            std::unique_lock<std::mutex> timeLock(_time_mutex);
+            deviceRate = pendingDeviceRate;
+        }
+        decimation = pendingDecimation;
+        resampleRatio = pendingRatio;
+        resetBuffer = true;
+        ncoChanged.store(true);
+        channelsChanged.store(true);
+        ratePending.store(false);
+        return;
+    }
+
+    //the request stays pending and is retried until the callback catches up
+    if (chainsPending.load())
+    {
+        if (!rateStalled) SoapySDR_logf(SOAPY_SDR_WARNING, "Sample rate change to %d delayed, the stream is not delivering", (int) pendingRate);
+        rateStalled = true;
+        return;
+    }
+
+    if (pendingDeviceRate != deviceRate)
+    {
+        switchDeviceRate();
+        ratePending.store(false);
+        return;
+    }
+
+    //same device rate: only the chains change, swapped in by the callback,
+    //their filter state is sized and locked here rather than on the audio thread
+    const bool locked = memoryLocked.load();
+    std::vector<std::vector<float> *> buffers;
+    for (auto &chain : nextChains) chain.getBuffers(buffers);
+    if (locked) lockBuffers(buffers, false);
+    nextChains.assign(rxChains.size(), AudioRxChain());
+    buffers.clear();
+    for (auto &chain : nextChains)
+    {
+        chain.configure(pendingDecimation, pendingRatio);
+        chain.reserve(bufferLength);
+        chain.getBuffers(buffers);
+    }
+    if (locked && !lockBuffers(buffers, true)) memoryLocked.store(false);
+    nextRate = pendingRate;
+    nextDecimation = pendingDecimation;
+    nextRatio = pendingRatio;
+    chainsPending.store(true);
+    ratePending.store(false);
+}
+
+void SoapyAudio::switchDeviceRate(void)
+{
+    const uint32_t oldRate = deviceRate;
+
+    //open the new rate on a second handle while the old one still runs,
+    //backends that cannot open a device twice fall back to a reopen
+    bool standby = false;
+    unsigned int standbyLength = bufferLength;
+    if (!duplexMode && aggregateCards.empty())
+    {
+        try {
+            if (!standbyDac) standbyDac.reset(new RtAudio(dac->getCurrentApi()));
+            standbyDac->showWarnings(false);
+            standbyDac->openStream(NULL, &inputParameters, RTAUDIO_FLOAT32, pendingDeviceRate, &standbyLength, &_rx_callback, (void *) this, &opts);
+            standby = true;
+        } catch (RtAudioError& e) {
+            SoapySDR_logf(SOAPY_SDR_DEBUG, "Standby stream unavailable: %s", e.getMessage().c_str());
+        }
+    }
+
+    try {
+        if (dac->isStreamRunning()) dac->stopStream();
+    } catch (RtAudioError& e) {
+        SoapySDR_logf(SOAPY_SDR_ERROR, "Stopping stream for rate change: %s", e.getMessage().c_str());
+    }
+
+    //the timeline continues across the change, the gap is marked instead
+    {
+        std::unique_lock<std::mutex> timeLock(_time_mutex);
+        timeBaseNs += (long long)(deviceTicks.load() * (1e9 / oldRate));
+        deviceTicks.store(0);
+        deviceRate = pendingDeviceRate;
+    }
+
+    sampleRate = pendingRate;
+    decimation = pendingDecimation;
+    resampleRatio = pendingRatio;
+    configureDSP();
+    {
+        std::unique_lock<std::mutex> lock(_buf_mutex);
+        _discontinuity = true;
+    }
+
+    try {
+        if (standby)
+        {
+            bufferLength = standbyLength;
+            _convBuff.resize(bufferLength * 2 * rxChains.size());
+            reserveStreamBuffers();
+            threadPending.store(true);
+            standbyDac->startStream();
+            std::swap(dac, standbyDac);
+            closeDeviceStream(*standbyDac);
+            if (lockMemory) lockStreamMemory(true);
+        }
+        else
+        {
+            closeDeviceStream(*dac);
+            openDeviceStream();
+            startDeviceStream();
+        }
+    } catch (std::exception& e) {
+        SoapySDR_logf(SOAPY_SDR_ERROR, "Sample rate change to %d failed: %s", (int) sampleRate, e.what());
+
+        //nothing is left streaming, readStream reports it until the next activation
+        for (RtAudio *device : {standbyDac.get(), dac.get()})
+        {
+            if (device == nullptr) continue;
+            try {
+                closeDeviceStream(*device);
+            } catch (RtAudioError&) {
+            }
+        }
+        rxActive.store(false);
+        streamActive = false;
+        rateFailed.store(true);
+    }
+}
+
+RtAudio &SoapyAudio::txDevice(void)
+{
+    return duplexMode ? *dac : *txDac;
+}
+
+void SoapyAudio::openDeviceStream(void)
+{
+#ifndef _MSC_VER
+    opts.priority = (schedPriority > 0) ? schedPriority : sched_get_priority_max(SCHED_FIFO);
+#endif
+    //    opts.flags = RTAUDIO_MINIMIZE_LATENCY;
+    opts.flags = (schedPolicy == "other") ? 0 : RTAUDIO_SCHEDULE_REALTIME;
+    opts.flags |= deviceFlags;
+#ifdef RTAUDIO_SOAPY_EXTENSIONS
+    if (lockMemory) opts.flags |= RTAUDIO_LOCK_MEMORY;
+    if (alsaMmap) opts.flags |= RTAUDIO_ALSA_USE_MMAP;
+    if (alsaPoll) opts.flags |= RTAUDIO_ALSA_POLL_CAPTURE;
+    opts.availMin = availMin;
+
+    //jack follows the server rate and hands its port buffers over in place,
+    //an aggregate keeps the interleaved layout the cards share
+    opts.flags |= RTAUDIO_JACK_SERVER_RATE;
+    if (aggregateCards.empty()) opts.flags |= RTAUDIO_JACK_PORT_BUFFERS;
+    opts.jackPorts = jackPorts;
+#endif
+    if (planar) opts.flags |= RTAUDIO_NONINTERLEAVED;
+    //openStream replaces these with what the device accepted
+    opts.numberOfBuffers = periodCount;
+    if (periodFrames != 0) bufferLength = periodFrames;
+
+    if (!duplexMode)
+    {
+        dac->openStream(NULL, &inputParameters, RTAUDIO_FLOAT32, deviceRate, &bufferLength, &_rx_callback, (void *) this, &opts);
+#ifdef RTAUDIO_SOAPY_EXTENSIONS
+        portBuffers = (opts.flags & RTAUDIO_JACK_PORT_BUFFERS) && dac->getCurrentApi() == RtAudio::UNIX_JACK;
+#endif
+        if (dac->getStreamSampleRate() != deviceRate)
+        {
+            try {
+                adoptDeviceRate(dac->getStreamSampleRate());
+            } catch (...) {
+                closeDeviceStream(*dac);
+                throw;
+            }
+        }
+        _convBuff.resize(bufferLength * 2 * rxChains.size());
+        if (aggregateCards.empty()) return;
+
+        //the other cards open with the same period and get reset onto a new timeline
+        aggregateDelay = AGGREGATE_DELAY_PERIODS * bufferLength;
+        _delayBuffs.assign(cardChannels.size(), std::vector<float>(aggregateDelay * 2, 0.0f));
+        for (auto &delay : _delayBuffs) delay.reserve((aggregateDelay + bufferLength) * 2);
+        {
+            std::unique_lock<std::mutex> lock(_clock_mutex);
+            clockValid = false;
+        }
+
+        //opts keeps the geometry of the first card for reporting
+        RtAudio::StreamOptions cardOpts = opts;
+        cardOpts.jackPorts.clear();
+        for (auto &card : aggregateCards)
+        {
+            card->inputParameters = inputParameters;
+            card->inputParameters.deviceId = card->deviceId;
+            card->bufferLength = bufferLength;
+            card->sampleOffsetBuffer[0] = card->sampleOffsetBuffer[1] = 0;
+            card->rateEstimator.reset(deviceRate);
+            card->resamplers.resize(cardChannels.size());
+            for (auto &resampler : card->resamplers) resampler.configure(1.0);
+            card->fifos.assign(cardChannels.size(), std::vector<float>());
+            card->aligned = false;
+
+            card->dac->openStream(NULL, &card->inputParameters, RTAUDIO_FLOAT32, deviceRate, &card->bufferLength,
+                    &_aggregate_callback, (void *) card.get(), &cardOpts);
+            card->convBuff.resize(card->bufferLength * 2 * cardChannels.size());
+            card->inputs.resize(card->inputParameters.nChannels);
+        }
+        return;
+    }
+
+    if (inputParameters.nChannels == 0 || outputParameters.nChannels == 0)
+    {
+        throw std::runtime_error("duplex mode needs both an RX and a TX stream set up");
+    }
+
+    dac->openStream(&outputParameters, &inputParameters, RTAUDIO_FLOAT32, deviceRate, &bufferLength, &_duplex_callback, (void *) this, &opts);
+    portBuffers = false;
+    _convBuff.resize(bufferLength * 2 * rxChains.size());
+
+    //tx slots hold one shared period
+    if (txBufferLength != bufferLength)
+    {
+        txBufferLength = bufferLength;
+        txRing.configure(numBuffers, txBufferLength * 2);
+        txReading = false;
+        txWriting = false;
+    }
+}
+
+void SoapyAudio::startDeviceStream(void)
+{
+    reserveStreamBuffers();
+    if (lockMemory) lockStreamMemory(true);
+    threadPending.store(true);
+    for (auto &card : aggregateCards) card->threadPending.store(true);
+
+    //aggregate cards start back to back, the timeline absorbs the remaining offset
+    dac->startStream();
+    for (auto &card : aggregateCards) card->dac->startStream();
+}
+
+void SoapyAudio::configureCaptureThread(const bool primary)
+{
+    const char *name = primary ? "Capture thread" : "Aggregate card thread";
+
+#ifndef _MSC_VER
+    //an explicit class replaces whatever the backend gave the thread,
+    //backends that fall back quietly are caught by the report below
+    if (!schedPolicy.empty())
+    {
+        const int policy = (schedPolicy == "fifo") ? SCHED_FIFO : (schedPolicy == "rr") ? SCHED_RR : SCHED_OTHER;
+        sched_param param;
+        param.sched_priority = 0;
+        if (policy != SCHED_OTHER)
+        {
+            const int max = sched_get_priority_max(policy);
+            param.sched_priority = std::max(std::min((schedPriority > 0) ? schedPriority : max, max), sched_get_priority_min(policy));
+        }
+        const int ret = pthread_setschedparam(pthread_self(), policy, &param);
+        if (ret != 0)
+        {
+            SoapySDR_logf(SOAPY_SDR_WARNING, "%s: %s priority %d refused, %s", name, schedPolicy.c_str(), param.sched_priority, std::strerror(ret));
+        }
+    }
+#endif
+
+    bool pinned = false;
+#ifdef __linux__
+    if (!cpuAffinity.empty())
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (auto cpu : cpuAffinity)
+        {
+            if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &cpus);
+        }
+        const int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        pinned = (ret == 0);
+        if (ret != 0) SoapySDR_logf(SOAPY_SDR_WARNING, "%s: cpu_affinity refused, %s", name, std::strerror(ret));
+    }
+#endif
+    if (!primary) return;
+
+    //what the thread ended up with, whoever chose it
+    int policy = -1, priority = 0;
+#ifndef _MSC_VER
+    sched_param param;
+    if (pthread_getschedparam(pthread_self(), &policy, &param) == 0) priority = param.sched_priority;
+    else policy = -1;
+#endif
+    threadPolicy.store(policy);
+    threadPriority.store(priority);
+    threadPinned.store(pinned);
+
+    SoapySDR_logf(SOAPY_SDR_INFO, "%s: %s%s%s", name, captureThreadPolicy().c_str(),
+            pinned ? ", pinned" : "", memoryLocked.load() ? ", memory locked" : "");
+}
+
+std::string SoapyAudio::captureThreadPolicy(void) const
+{
+    const int policy = threadPolicy.load();
+    std::string name = "unknown";
+#ifndef _MSC_VER
+    if (policy == SCHED_FIFO) name = "fifo";
+    else if (policy == SCHED_RR) name = "rr";
+    else if (policy == SCHED_OTHER) name = "other";
+#endif
+    if (policy < 0) return "";
+    return name + " " + std::to_string(threadPriority.load());
+}
+
+size_t SoapyAudio::rxPlaneCapacity(const size_t numFrames) const
+{
+    //decimation and resampling never raise the rate,
+    //rate correction and the card servos stay well within a sixteenth
+    return numFrames + numFrames / 16 + 4;
+}
+
+void SoapyAudio::reserveStreamBuffers(void)
+{
+    //sized for the period the device accepted, the callbacks then
+    //resize within capacity and never allocate on the audio thread
+    if (lockMemory) lockStreamMemory(false);
+
+    const size_t planeCapacity = rxPlaneCapacity(bufferLength);
+    for (auto &chain : rxChains) chain.reserve(bufferLength);
+    for (auto &chain : nextChains) chain.reserve(bufferLength);
+    _wideBuff.reserve(planeCapacity * 2 * rxChains.size());
+    if (numChannelizerChannels > 0)
+    {
+        channelizer.reserve(planeCapacity);
+        _chanBuff.reserve((planeCapacity / numChannelizerChannels + 1) * 2 * numChannelizerChannels);
     }
+    {
+        std::unique_lock<std::mutex> lock(_buf_mutex);
+        _buffCapacity = planeCapacity * 2 * streamChannels.size();
 
-    //clear async fifo counts
-    _buf_tail = 0;
-    _buf_count = 0;
-    _buf_head = 0;
+        //slots the reader has queued or holds end at the tail,
+        //they keep their storage until they are released
+        for (size_t i = 0; i + _buf_count < numBuffers; i++) reserveSlot((_buf_tail + i) % numBuffers);
+    }
+    if (aggregateCards.empty()) return;
 
-    //allocate buffers
-    _buffs.resize(numBuffers);
-    for (auto &buff : _buffs) buff.reserve(bufferLength);
-    for (auto &buff : _buffs) buff.resize(bufferLength);
+    const size_t perCard = cardChannels.size();
+    _cardBuff.reserve(perCard * bufferLength * 2 * (aggregateCards.size() + 1));
+    for (auto &card : aggregateCards)
+    {
+        //a queue is realigned once it holds two delays and periods
+        const size_t cardCapacity = rxPlaneCapacity(card->bufferLength);
+        card->resampBuff.reserve(perCard * cardCapacity * 2);
+        for (auto &resampler : card->resamplers) resampler.reserve(card->bufferLength);
+        for (auto &fifo : card->fifos) fifo.reserve((2 * (aggregateDelay + card->bufferLength) + cardCapacity) * 2);
+    }
+}
 
-    return (SoapySDR::Stream *) this;
+void SoapyAudio::reserveSlot(const size_t handle)
+{
+    //called with _buf_mutex held on a slot the callback is not filling
+    auto &buff = _buffs[handle];
+    if (buff.capacity() >= _buffCapacity) return;
+#ifndef _WIN32
+    const bool locked = memoryLocked.load();
+    if (locked && buff.capacity() != 0) munlock(buff.data(), buff.capacity() * sizeof(float));
+    buff.reserve(_buffCapacity);
+    if (locked && mlock(buff.data(), buff.capacity() * sizeof(float)) != 0)
+    {
+        memoryLocked.store(false);
+    }
+#else
+    buff.reserve(_buffCapacity);
+#endif
 }
 
-void SoapyAudio::closeStream(SoapySDR::Stream *stream)
+void SoapyAudio::lockStreamMemory(const bool lock)
 {
-    _buffs.clear();
+    //the ring, the filter state and every scratch buffer the callbacks touch,
+    //RtAudio locks its own buffers
+    std::vector<std::vector<float> *> buffers;
+    bool locked = true;
+    {
+        std::unique_lock<std::mutex> bufLock(_buf_mutex);
+        for (auto &buff : _buffs) buffers.push_back(&buff);
+        locked = lockBuffers(buffers, lock);
+    }
+
+    buffers.clear();
+    buffers.push_back(&_convBuff);
+    buffers.push_back(&_wideBuff);
+    buffers.push_back(&_chanBuff);
+    buffers.push_back(&_cardBuff);
+    for (auto &delay : _delayBuffs) buffers.push_back(&delay);
+    for (auto &chain : rxChains) chain.getBuffers(buffers);
+    for (auto &chain : nextChains) chain.getBuffers(buffers);
+    if (numChannelizerChannels > 0) channelizer.getBuffers(buffers);
+    for (auto &card : aggregateCards)
+    {
+        buffers.push_back(&card->convBuff);
+        buffers.push_back(&card->resampBuff);
+        for (auto &fifo : card->fifos) buffers.push_back(&fifo);
+        for (auto &resampler : card->resamplers) resampler.getBuffers(buffers);
+    }
+    locked = lockBuffers(buffers, lock) && locked;
+
+    if (!lock)
+    {
+        memoryLocked.store(false);
+        return;
+    }
+
+#ifdef RTAUDIO_SOAPY_EXTENSIONS
+    locked = locked && dac->isStreamMemoryLocked();
+#endif
+    memoryLocked.store(locked);
+    if (!locked) SoapySDR_log(SOAPY_SDR_WARNING, "Locking the stream buffers into memory failed, check RLIMIT_MEMLOCK.");
 }
 
-size_t SoapyAudio::getStreamMTU(SoapySDR::Stream *stream) const
+void SoapyAudio::closeDeviceStream(RtAudio &device)
 {
-    return bufferLength / elementsPerSample;
+    if (device.isStreamRunning()) {
+        device.stopStream();
+    }
+    if (device.isStreamOpen()) {
+        device.closeStream();
+    }
+    if (&device != dac.get()) return;
+
+    for (auto &card : aggregateCards)
+    {
+        if (card->dac->isStreamRunning()) {
+            card->dac->stopStream();
+        }
+        if (card->dac->isStreamOpen()) {
+            card->dac->closeStream();
+        }
+    }
 }
 
 int SoapyAudio::activateStream(
@@ -224,24 +1456,86 @@ int SoapyAudio::activateStream(
         const size_t numElems)
 {
     if (flags != 0) return SOAPY_SDR_NOT_SUPPORTED;
-    resetBuffer = true;
-    bufferedElems = 0;
 
-    try {
-#ifndef _MSC_VER
-        opts.priority = sched_get_priority_max(SCHED_FIFO);
-#endif
-        //    opts.flags = RTAUDIO_MINIMIZE_LATENCY;
-        opts.flags = RTAUDIO_SCHEDULE_REALTIME;
+    //serialized with rate changes in flight on the control thread
+    std::unique_lock<std::mutex> rateLock(_rate_mutex);
+    if (!rateThread.joinable()) rateThread = std::thread(&SoapyAudio::rateThreadLoop, this);
+
+    //a shared duplex stream is restarted, so neither direction
+    //gets reset underneath a running callback
+    RtAudio &device = isTxStream(stream) ? txDevice() : *dac;
+    closeDeviceStream(device);
+
+    if (isTxStream(stream))
+    {
+        txRing.clear();
+        txBurst.store(false);
+        txReading = false;
+        txWriting = false;
+        txActive.store(true);
+    }
+    else
+    {
+        resetBuffer = true;
+        bufferedElems = 0;
+        sampleOffsetBuffer[0] = sampleOffsetBuffer[1] = 0;
+        rateFailed.store(false);
+        if (chainsPending.exchange(false))
+        {
+            sampleRate = nextRate;
+            decimation = nextDecimation;
+            resampleRatio = nextRatio;
+        }
+        configureDSP();
+        rxActive.store(true);
+    }
 
-        sampleRateChanged.store(false);
-        dac.openStream(NULL, &inputParameters, RTAUDIO_FLOAT32, sampleRate, &bufferLength, &_rx_callback, (void *) this, &opts);
-        dac.startStream();
+    //nothing is left open or marked active behind a failed activation
+    auto abandon = [&]()
+    {
+        try {
+            closeDeviceStream(device);
+        } catch (RtAudioError&) {
+        }
+        if (isTxStream(stream)) txActive.store(false);
+        else rxActive.store(false);
+        streamActive = rxActive.load();
+    };
 
-        streamActive = true;
+    try {
+        if (isTxStream(stream) && !duplexMode)
+        {
+            openTxStream();
+            txDac->startStream();
+        }
+        else
+        {
+            //a reopened device starts a new timeline
+            {
+                std::unique_lock<std::mutex> timeLock(_time_mutex);
+                deviceTicks.store(0);
+                timeBaseNs = 0;
+            }
+            _discontinuity = false;
+            std::fill(_buffDiscontinuity.begin(), _buffDiscontinuity.end(), 0);
+            openDeviceStream();
+#ifdef RTAUDIO_SOAPY_EXTENSIONS
+            SoapySDR_logf(SOAPY_SDR_INFO, "Device buffer %u frames x %u periods, avail_min %u",
+                    bufferLength, opts.numberOfBuffers, opts.availMin);
+#else
+            SoapySDR_logf(SOAPY_SDR_INFO, "Device buffer %u frames x %u periods", bufferLength, opts.numberOfBuffers);
+#endif
+            startDeviceStream();
+        }
     } catch (RtAudioError& e) {
+        abandon();
         throw std::runtime_error("RtAudio init error '" + e.getMessage());
+    } catch (...) {
+        abandon();
+        throw;
     }
+
+    streamActive = rxActive.load();
     
     return 0;
 }
@@ -250,14 +1544,16 @@ int SoapyAudio::deactivateStream(SoapySDR::Stream *stream, const int flags, cons
 {
     if (flags != 0) return SOAPY_SDR_NOT_SUPPORTED;
 
-    if (dac.isStreamRunning()) {
-        dac.stopStream();
-    }
-    if (dac.isStreamOpen()) {
-        dac.closeStream();
-    }
-    
-    streamActive = false;
+    std::unique_lock<std::mutex> rateLock(_rate_mutex);
+
+    if (isTxStream(stream)) txActive.store(false);
+    else rxActive.store(false);
+    streamActive = rxActive.load();
+
+    //the other direction keeps a shared duplex stream running
+    if (duplexMode && (rxActive.load() || txActive.load())) return 0;
+
+    closeDeviceStream(isTxStream(stream) ? txDevice() : *dac);
     
     return 0;
 }
@@ -270,352 +1566,94 @@ int SoapyAudio::readStream(
         long long &timeNs,
         const long timeoutUs)
 {    
-    if (!dac.isStreamRunning()) {
-        return 0;
+    //rate changes are applied on the control thread, the ring keeps
+    //delivering while the device is reconfigured
+    if (rateFailed.load()) {
+        return SOAPY_SDR_STREAM_ERROR;
     }
-    
-    if (sampleRateChanged.load()) {
-        if (dac.isStreamRunning()) {
-            dac.stopStream();
-        }
-        if (dac.isStreamOpen()) {
-            dac.closeStream();
-        }
-        dac.openStream(NULL, &inputParameters, RTAUDIO_FLOAT32, sampleRate, &bufferLength, &_rx_callback, (void *) this, &opts);
-        dac.startStream();
-        sampleRateChanged.store(false);
+    if (!rxActive.load()) {
+        return 0;
     }
 
-    //this is the user's buffer for channel 0
-    void *buff0 = buffs[0];
-
     //are elements left in the buffer? if not, do a new read.
-    if (bufferedElems == 0 || (sampleOffset && (bufferedElems < abs(sampleOffset))))
+    if (bufferedElems == 0)
     {
-        int ret = this->acquireReadBuffer(stream, _currentHandle, (const void **)&_currentBuff, flags, timeNs, timeoutUs);
+        int ret = this->acquireReadBuffer(stream, _currentHandle, (const void **)_currentBuffs.data(), flags, timeNs, timeoutUs);
         if (ret < 0) return ret;
         bufferedElems = ret;
+        _currentElems = ret;
+        _currentTimeNs = timeNs;
     }
 
+    //time of the first returned sample within the current buffer
+    timeNs = _currentTimeNs + (long long)((_currentElems - bufferedElems) * (1e9 / sampleRate));
+    flags |= SOAPY_SDR_HAS_TIME;
+
     size_t returnedElems = std::min(bufferedElems, numElems);
 
-    if (sampleOffset && (bufferedElems < abs(sampleOffset))) {
-        return 0;
+    //convert each channel plane into the user's buffers
+    for (size_t i = 0; i < _currentBuffs.size(); i++)
+    {
+        convertOutput(_currentBuffs[i], buffs[i], returnedElems);
+        _currentBuffs[i] += returnedElems * 2;
     }
 
-    //convert into user's buff0
-    if (sampleOffset) {
-        if (asFormat == AUDIO_FORMAT_FLOAT32)
-        {
-            float *ftarget = (float *) buff0;
-            std::complex<float> tmp;
-            if (cSetup == FORMAT_MONO_L || cSetup == FORMAT_MONO_R) {
-                for (size_t i = 0; i < returnedElems; i++)
-                {
-                    ftarget[i * 2] = _currentBuff[i];
-                    ftarget[i * 2 + 1] = 0;
-                }            
-            }
-            else if (cSetup == FORMAT_STEREO_IQ) {
-                if (sampleOffset > 0) {
-                    size_t iStart = abs(sampleOffset);
-                    for (size_t i = 0; i < iStart; i++) {
-                        ftarget[i * 2] = sampleOffsetBuffer[i];
-                        ftarget[i * 2 + 1] = _currentBuff[i * 2 + 1]; 
-                    }            
-                    for (size_t i = iStart; i < returnedElems; i++) {
-                        ftarget[i * 2] = _currentBuff[(i + iStart) * 2];
-                        ftarget[i * 2 + 1] = _currentBuff[i * 2 + 1];
-                    }            
-                    for (size_t i = 0; i < iStart; i++) {
-                        sampleOffsetBuffer[i] = _currentBuff[(returnedElems-iStart+i) * 2];
-                    }                  
-                } else {
-                    size_t iStart = abs(sampleOffset);
-                    for (size_t i = 0; i < iStart; i++) {
-                        ftarget[i * 2] = _currentBuff[i * 2];
-                        ftarget[i * 2 + 1] = sampleOffsetBuffer[i];
-                    }            
-                    for (size_t i = iStart; i < returnedElems; i++) {
-                        ftarget[i * 2] = _currentBuff[i * 2];
-                        ftarget[i * 2 + 1] = _currentBuff[(i + iStart) * 2 + 1];
-                    }            
-                    for (size_t i = 0; i < iStart; i++) {
-                        sampleOffsetBuffer[i] = _currentBuff[(returnedElems-iStart+i) * 2 + 1];
-                    }
-                }
-            }
-            else if (cSetup == FORMAT_STEREO_QI) {
-                if (sampleOffset > 0) {
-                    size_t iStart = abs(sampleOffset);
-                    for (size_t i = 0; i < iStart; i++) {
-                        ftarget[i * 2 + 1] = sampleOffsetBuffer[i];
-                        ftarget[i * 2] = _currentBuff[i * 2 + 1]; 
-                    }            
-                    for (size_t i = iStart; i < returnedElems; i++) {
-                        ftarget[i * 2 + 1] = _currentBuff[(i + iStart) * 2];
-                        ftarget[i * 2] = _currentBuff[i * 2 + 1];
-                    }            
-                    for (size_t i = 0; i < iStart; i++) {
-                        sampleOffsetBuffer[i] = _currentBuff[(returnedElems-iStart+i) * 2];
-                    }                  
-                } else {
-                    size_t iStart = abs(sampleOffset);
-                    for (size_t i = 0; i < iStart; i++) {
-                        ftarget[i * 2 + 1] = _currentBuff[i * 2];
-                        ftarget[i * 2] = sampleOffsetBuffer[i];
-                    }            
-                    for (size_t i = iStart; i < returnedElems; i++) {
-                        ftarget[i * 2 + 1] = _currentBuff[i * 2];
-                        ftarget[i * 2] = _currentBuff[(i + iStart) * 2 + 1];
-                    }            
-                    for (size_t i = 0; i < iStart; i++) {
-                        sampleOffsetBuffer[i] = _currentBuff[(returnedElems-iStart+i) * 2 + 1];
-                    }
-                }
-            }            
-        }
-        else if (asFormat == AUDIO_FORMAT_INT16)
-        {
-            int16_t *itarget = (int16_t *) buff0;
-            std::complex<int16_t> tmp;
-            if (cSetup == FORMAT_MONO_L || cSetup == FORMAT_MONO_R) {
-                for (size_t i = 0; i < returnedElems; i++)
-                {
-                    itarget[i * 2] = int16_t(_currentBuff[i] * 32767.0);
-                    itarget[i * 2 + 1] = 0;
-                }
-            }
-            else if (cSetup == FORMAT_STEREO_IQ) {
-                if (sampleOffset > 0) {
-                    size_t iStart = abs(sampleOffset);
-                    for (size_t i = 0; i < iStart; i++) {
-                        itarget[i * 2] = int16_t(sampleOffsetBuffer[i] * 32767.0);
-                        itarget[i * 2 + 1] = int16_t(_currentBuff[i * 2 + 1] * 32767.0);
-                    }            
-                    for (size_t i = iStart; i < returnedElems; i++) {
-                        itarget[i * 2] = int16_t(_currentBuff[(i + iStart) * 2] * 32767.0);
-                        itarget[i * 2 + 1] = int16_t(_currentBuff[i * 2 + 1] * 32767.0);
-                    }            
-                    for (size_t i = 0; i < iStart; i++) {
-                        sampleOffsetBuffer[i] = _currentBuff[(returnedElems-iStart+i) * 2];
-                    }                  
-                } else {
-                    size_t iStart = abs(sampleOffset);
-                    for (size_t i = 0; i < iStart; i++) {
-                        itarget[i * 2] = int16_t(_currentBuff[i * 2] * 32767.0);
-                        itarget[i * 2 + 1] = int16_t(sampleOffsetBuffer[i] * 32767.0);
-                    }            
-                    for (size_t i = iStart; i < returnedElems; i++) {
-                        itarget[i * 2] = int16_t(_currentBuff[i * 2] * 32767.0);
-                        itarget[i * 2 + 1] = int16_t(_currentBuff[(i + iStart) * 2 + 1] * 32767.0);
-                    }            
-                    for (size_t i = 0; i < iStart; i++) {
-                        sampleOffsetBuffer[i] = _currentBuff[(returnedElems-iStart+i) * 2 + 1];
-                    }
-                }
-            }
-            if (cSetup == FORMAT_STEREO_QI) {
-                if (sampleOffset > 0) {
-                    size_t iStart = abs(sampleOffset);
-                    for (size_t i = 0; i < iStart; i++) {
-                        itarget[i * 2 + 1] = int16_t(sampleOffsetBuffer[i] * 32767.0);
-                        itarget[i * 2] = int16_t(_currentBuff[i * 2 + 1] * 32767.0);
-                    }            
-                    for (size_t i = iStart; i < returnedElems; i++) {
-                        itarget[i * 2 + 1] = int16_t(_currentBuff[(i + iStart) * 2] * 32767.0);
-                        itarget[i * 2] = int16_t(_currentBuff[i * 2 + 1] * 32767.0);
-                    }            
-                    for (size_t i = 0; i < iStart; i++) {
-                        sampleOffsetBuffer[i] = _currentBuff[(returnedElems-iStart+i) * 2];
-                    }                  
-                } else {
-                    size_t iStart = abs(sampleOffset);
-                    for (size_t i = 0; i < iStart; i++) {
-                        itarget[i * 2 + 1] = int16_t(_currentBuff[i * 2] * 32767.0);
-                        itarget[i * 2] = int16_t(sampleOffsetBuffer[i] * 32767.0);
-                    }            
-                    for (size_t i = iStart; i < returnedElems; i++) {
-                        itarget[i * 2 + 1] = int16_t(_currentBuff[i * 2] * 32767.0);
-                        itarget[i * 2] = int16_t(_currentBuff[(i + iStart) * 2 + 1] * 32767.0);
-                    }            
-                    for (size_t i = 0; i < iStart; i++) {
-                        sampleOffsetBuffer[i] = _currentBuff[(returnedElems-iStart+i) * 2 + 1];
-                    }
-                }
-            }
-        }
-        else if (asFormat == AUDIO_FORMAT_INT8)
-        {
-            int8_t *itarget = (int8_t *) buff0;
-            if (cSetup == FORMAT_MONO_L || cSetup == FORMAT_MONO_R) {
-                for (size_t i = 0; i < returnedElems; i++)
-                {
-                    itarget[i * 2] = int8_t(_currentBuff[i] * 127.0);
-                    itarget[i * 2 + 1] = 0;
-                }
-            }
-            else if (cSetup == FORMAT_STEREO_IQ) {
-                if (sampleOffset > 0) {
-                    size_t iStart = abs(sampleOffset);
-                    for (size_t i = 0; i < iStart; i++) {
-                        itarget[i * 2] = int16_t(sampleOffsetBuffer[i] * 127.0);
-                        itarget[i * 2 + 1] = int16_t(_currentBuff[i * 2 + 1] * 127.0);
-                    }            
-                    for (size_t i = iStart; i < returnedElems; i++) {
-                        itarget[i * 2] = int16_t(_currentBuff[(i + iStart) * 2] * 127.0);
-                        itarget[i * 2 + 1] = int16_t(_currentBuff[i * 2 + 1] * 127.0);
-                    }            
-                    for (size_t i = 0; i < iStart; i++) {
-                        sampleOffsetBuffer[i] = _currentBuff[(returnedElems-iStart+i) * 2];
-                    }                  
-                } else {
-                    size_t iStart = abs(sampleOffset);
-                    for (size_t i = 0; i < iStart; i++) {
-                        itarget[i * 2] = int16_t(_currentBuff[i * 2] * 127.0);
-                        itarget[i * 2 + 1] = int16_t(sampleOffsetBuffer[i] * 127.0);
-                    }            
-                    for (size_t i = iStart; i < returnedElems; i++) {
-                        itarget[i * 2] = int16_t(_currentBuff[i * 2] * 127.0);
-                        itarget[i * 2 + 1] = int16_t(_currentBuff[(i + iStart) * 2 + 1] * 127.0);
-                    }            
-                    for (size_t i = 0; i < iStart; i++) {
-                        sampleOffsetBuffer[i] = _currentBuff[(returnedElems-iStart+i) * 2 + 1];
-                    }
-                }
-            }
-            if (cSetup == FORMAT_STEREO_QI) {
-                if (sampleOffset > 0) {
-                    size_t iStart = abs(sampleOffset);
-                    for (size_t i = 0; i < iStart; i++) {
-                        itarget[i * 2 + 1] = int16_t(sampleOffsetBuffer[i] * 127.0);
-                        itarget[i * 2] = int16_t(_currentBuff[i * 2 + 1] * 127.0);
-                    }            
-                    for (size_t i = iStart; i < returnedElems; i++) {
-                        itarget[i * 2 + 1] = int16_t(_currentBuff[(i + iStart) * 2] * 127.0);
-                        itarget[i * 2] = int16_t(_currentBuff[i * 2 + 1] * 127.0);
-                    }            
-                    for (size_t i = 0; i < iStart; i++) {
-                        sampleOffsetBuffer[i] = _currentBuff[(returnedElems-iStart+i) * 2];
-                    }                  
-                } else {
-                    size_t iStart = abs(sampleOffset);
-                    for (size_t i = 0; i < iStart; i++) {
-                        itarget[i * 2 + 1] = int16_t(_currentBuff[i * 2] * 127.0);
-                        itarget[i * 2] = int16_t(sampleOffsetBuffer[i] * 127.0);
-                    }            
-                    for (size_t i = iStart; i < returnedElems; i++) {
-                        itarget[i * 2 + 1] = int16_t(_currentBuff[i * 2] * 127.0);
-                        itarget[i * 2] = int16_t(_currentBuff[(i + iStart) * 2 + 1] * 127.0);
-                    }            
-                    for (size_t i = 0; i < iStart; i++) {
-                        sampleOffsetBuffer[i] = _currentBuff[(returnedElems-iStart+i) * 2 + 1];
-                    }
-                }
-            }            
-        } 
-    } else {
-        if (asFormat == AUDIO_FORMAT_FLOAT32)
-        {
-            float *ftarget = (float *) buff0;
-            std::complex<float> tmp;
-            if (cSetup == FORMAT_MONO_L || cSetup == FORMAT_MONO_R) {
-                for (size_t i = 0; i < returnedElems; i++)
-                {
-                    ftarget[i * 2] = _currentBuff[i];
-                    ftarget[i * 2 + 1] = 0;
-                }            
-            }
-            else if (cSetup == FORMAT_STEREO_IQ) {
-                for (size_t i = 0; i < returnedElems; i++)
-                {
-                    ftarget[i * 2] = _currentBuff[i * 2];
-                    ftarget[i * 2 + 1] = _currentBuff[i * 2 + 1];
-                }            
-            }
-            else if (cSetup == FORMAT_STEREO_QI) {
-                for (size_t i = 0; i < returnedElems; i++)
-                {
-                    ftarget[i * 2] = _currentBuff[i * 2 + 1];
-                    ftarget[i * 2 + 1] = _currentBuff[i * 2];
-                }            
-            }            
-        }
-        else if (asFormat == AUDIO_FORMAT_INT16)
-        {
-            int16_t *itarget = (int16_t *) buff0;
-            std::complex<int16_t> tmp;
-            if (cSetup == FORMAT_MONO_L || cSetup == FORMAT_MONO_R) {
-                for (size_t i = 0; i < returnedElems; i++)
-                {
-                    itarget[i * 2] = int16_t(_currentBuff[i] * 32767.0);
-                    itarget[i * 2 + 1] = 0;
-                }
-            }
-            else if (cSetup == FORMAT_STEREO_IQ) {
-                for (size_t i = 0; i < returnedElems; i++)
-                {
-                    itarget[i * 2] = int16_t(_currentBuff[i * 2] * 32767.0);
-                    itarget[i * 2 + 1] = int16_t(_currentBuff[i * 2 + 1] * 32767.0);
-                }
-            }
-            else if (cSetup == FORMAT_STEREO_QI) {
-                for (size_t i = 0; i < returnedElems; i++)
-                {
-                    itarget[i * 2] = int16_t(_currentBuff[i * 2 + 1] * 32767.0);
-                    itarget[i * 2 + 1] = int16_t(_currentBuff[i * 2] * 32767.0);
-                }            
-            }            
-        }
-        else if (asFormat == AUDIO_FORMAT_INT8)
-        {
-            int8_t *itarget = (int8_t *) buff0;
-            if (cSetup == FORMAT_MONO_L || cSetup == FORMAT_MONO_R) {
-                for (size_t i = 0; i < returnedElems; i++)
-                {
-                    itarget[i * 2] = int8_t(_currentBuff[i] * 127.0);
-                    itarget[i * 2 + 1] = 0;
-                }
-            }
-            else if (cSetup == FORMAT_STEREO_IQ) {
-                for (size_t i = 0; i < returnedElems; i++)
-                {
-                    itarget[i * 2] = int8_t(_currentBuff[i * 2] * 127.0);
-                    itarget[i * 2 + 1] = int8_t(_currentBuff[i * 2 + 1] * 127.0);
-                }
-            }
-            else if (cSetup == FORMAT_STEREO_QI) {
-                for (size_t i = 0; i < returnedElems; i++)
-                {
-                    itarget[i * 2] = int8_t(_currentBuff[i * 2 + 1] * 127.0);
-                    itarget[i * 2 + 1] = int8_t(_currentBuff[i * 2] * 127.0);
-                }            
-            }            
-        }
-    }
-    
     //bump variables for next call into readStream
     bufferedElems -= returnedElems;
-    _currentBuff += returnedElems * elementsPerSample;
 
-    //return number of elements written to buff0
+    //return number of elements written to each buffer
     if (bufferedElems != 0) flags |= SOAPY_SDR_MORE_FRAGMENTS;
     else this->releaseReadBuffer(stream, _currentHandle);
     return returnedElems;
 }
 
+void SoapyAudio::convertOutput(const float *iq, void *output, const size_t numElems) const
+{
+    if (asFormat == AUDIO_FORMAT_FLOAT32)
+    {
+        std::memcpy(output, iq, numElems * 2 * sizeof(float));
+    }
+    else if (asFormat == AUDIO_FORMAT_INT16)
+    {
+        int16_t *itarget = (int16_t *) output;
+        for (size_t i = 0; i < numElems * 2; i++)
+        {
+            itarget[i] = int16_t(clampSample(iq[i]) * 32767.0f);
+        }
+    }
+    else if (asFormat == AUDIO_FORMAT_INT8)
+    {
+        int8_t *itarget = (int8_t *) output;
+        for (size_t i = 0; i < numElems * 2; i++)
+        {
+            itarget[i] = int8_t(clampSample(iq[i]) * 127.0f);
+        }
+    }
+}
+
 /*******************************************************************
  * Direct buffer access API
  ******************************************************************/
 
 size_t SoapyAudio::getNumDirectAccessBuffers(SoapySDR::Stream *stream)
 {
+    if (isTxStream(stream)) return txRing.getNumSlots();
     return _buffs.size();
 }
 
 int SoapyAudio::getDirectAccessBufferAddrs(SoapySDR::Stream *stream, const size_t handle, void **buffs)
 {
-    buffs[0] = (void *)_buffs[handle].data();
+    if (isTxStream(stream))
+    {
+        buffs[0] = (void *) txRing.getSlot(handle);
+        return 0;
+    }
+
+    const size_t planeSize = _buffs[handle].size() / streamChannels.size();
+    for (size_t i = 0; i < streamChannels.size(); i++)
+    {
+        buffs[i] = (void *)(_buffs[handle].data() + i * planeSize);
+    }
     return 0;
 }
 
@@ -640,6 +1678,13 @@ int SoapyAudio::acquireReadBuffer(
         _overflowEvent = false;
     }
 
+    //the first buffer after a rate change is reported once before it is read
+    if (_buf_count != 0 && _buffDiscontinuity[_buf_head])
+    {
+        _buffDiscontinuity[_buf_head] = 0;
+        return SOAPY_SDR_OVERFLOW;
+    }
+
     //handle overflow from the rx callback thread
     if (_overflowEvent)
     {
@@ -661,11 +1706,16 @@ int SoapyAudio::acquireReadBuffer(
     //extract handle and buffer
     handle = _buf_head;
     _buf_head = (_buf_head + 1) % numBuffers;
-    buffs[0] = (void *)_buffs[handle].data();
-    flags = 0;
+    const size_t planeSize = _buffs[handle].size() / streamChannels.size();
+    for (size_t i = 0; i < streamChannels.size(); i++)
+    {
+        buffs[i] = (void *)(_buffs[handle].data() + i * planeSize);
+    }
+    flags = SOAPY_SDR_HAS_TIME;
+    timeNs = _buffTimes[handle];
 
     //return number available
-    return _buffs[handle].size() / elementsPerSample;
+    return planeSize / 2;
 }
 
 void SoapyAudio::releaseReadBuffer(
@@ -675,4 +1725,287 @@ void SoapyAudio::releaseReadBuffer(
     //TODO this wont handle out of order releases
     std::unique_lock <std::mutex> lock(_buf_mutex);
     _buf_count--;
+
+    //a slot held across a period change is grown here, off the audio thread,
+    //it only becomes the tail when the ring was full and the callback idle
+    reserveSlot(handle);
+}
+
+/*******************************************************************
+ * Transmit stream
+ ******************************************************************/
+
+bool SoapyAudio::isTxStream(SoapySDR::Stream *stream) const
+{
+    return stream == (SoapySDR::Stream *) &txRing;
+}
+
+SoapySDR::Stream *SoapyAudio::setupTxStream(const std::vector<size_t> &channels, const SoapySDR::Kwargs &args)
+{
+    if (devInfo.outputChannels == 0)
+    {
+        throw std::runtime_error("setupStream device has no outputs for TX");
+    }
+    if (channels.size() > 1 || (channels.size() == 1 && channels[0] != 0))
+    {
+        throw std::runtime_error("setupStream invalid channel selection");
+    }
+
+    txSetup = FORMAT_STEREO_IQ;
+    if (args.count("chan") != 0)
+    {
+        txSetup = chanSetupStrToEnum(args.at("chan"));
+    }
+
+    outputParameters.deviceId = deviceId;
+
+    switch (txSetup) {
+        case FORMAT_MONO_L:
+            outputParameters.nChannels = 1;
+            outputParameters.firstChannel = 0;
+            break;
+        case FORMAT_MONO_R:
+            outputParameters.nChannels = 1;
+            outputParameters.firstChannel = 1;
+            break;
+        case FORMAT_STEREO_IQ:
+        case FORMAT_STEREO_QI:
+            outputParameters.nChannels = 2;
+            outputParameters.firstChannel = 0;
+            break;
+        default:
+            throw std::runtime_error("setupStream TX supports mono_l, mono_r, stereo_iq and stereo_qi only");
+    }
+
+    if (outputParameters.firstChannel + outputParameters.nChannels > devInfo.outputChannels)
+    {
+        throw std::runtime_error("setupStream channel setup needs more outputs than the device has");
+    }
+
+    //each slot holds one device period of interleaved complex samples
+    txBufferLength = DEFAULT_BUFFER_LENGTH;
+    txRing.configure(numBuffers, txBufferLength * 2);
+
+    return (SoapySDR::Stream *) &txRing;
+}
+
+void SoapyAudio::openTxStream(void)
+{
+    RtAudio::StreamOptions txOpts = opts;
+#ifndef _MSC_VER
+    txOpts.priority = sched_get_priority_max(SCHED_FIFO);
+#endif
+    txOpts.flags = RTAUDIO_SCHEDULE_REALTIME | deviceFlags;
+
+    unsigned int frames = txBufferLength;
+    txDac->openStream(&outputParameters, NULL, RTAUDIO_FLOAT32, txSampleRate, &frames, &_tx_callback, (void *) this, &txOpts);
+
+    //the backend may negotiate another period, slots follow it
+    if (frames != txBufferLength)
+    {
+        txBufferLength = frames;
+        txRing.configure(numBuffers, txBufferLength * 2);
+    }
+}
+
+void SoapyAudio::convertTxInput(const void *input, float *iq, const size_t numElems) const
+{
+    if (txFormat == AUDIO_FORMAT_FLOAT32)
+    {
+        std::memcpy(iq, input, numElems * 2 * sizeof(float));
+    }
+    else if (txFormat == AUDIO_FORMAT_INT16)
+    {
+        const int16_t *isource = (const int16_t *) input;
+        for (size_t i = 0; i < numElems * 2; i++)
+        {
+            iq[i] = isource[i] * (1.0f / 32767.0f);
+        }
+    }
+    else if (txFormat == AUDIO_FORMAT_INT8)
+    {
+        const int8_t *isource = (const int8_t *) input;
+        for (size_t i = 0; i < numElems * 2; i++)
+        {
+            iq[i] = isource[i] * (1.0f / 127.0f);
+        }
+    }
+}
+
+void SoapyAudio::convertTxOutput(const float *iq, float *output, const size_t numFrames) const
+{
+    //float samples from the caller may exceed full scale,
+    //the device conversion to its native integer format does not clamp
+    switch (txSetup) {
+        case FORMAT_STEREO_IQ:
+            for (size_t i = 0; i < numFrames * 2; i++)
+            {
+                output[i] = clampSample(iq[i]);
+            }
+            break;
+        case FORMAT_STEREO_QI:
+            for (size_t i = 0; i < numFrames; i++)
+            {
+                output[i * 2] = clampSample(iq[i * 2 + 1]);
+                output[i * 2 + 1] = clampSample(iq[i * 2]);
+            }
+            break;
+        default:
+            //a single output carries the real part
+            for (size_t i = 0; i < numFrames; i++)
+            {
+                output[i] = clampSample(iq[i * 2]);
+            }
+            break;
+    }
+}
+
+int SoapyAudio::tx_callback(void *outputBuffer, unsigned int nBufferFrames, double streamTime, RtAudioStreamStatus status)
+{
+    float *output = (float *) outputBuffer;
+    const size_t frameSize = outputParameters.nChannels;
+
+    if (status & RTAUDIO_OUTPUT_UNDERFLOW) txUnderflows++;
+
+    //drain queued slots into the device period without locking
+    size_t numFrames = 0;
+    while (numFrames < nBufferFrames)
+    {
+        if (!txReading)
+        {
+            if (!txRing.acquireRead(txReadHandle, txReadLength)) break;
+            txReadOffset = 0;
+            txReading = true;
+        }
+
+        const size_t n = std::min<size_t>(nBufferFrames - numFrames, (txReadLength - txReadOffset) / 2);
+        convertTxOutput(txRing.getSlot(txReadHandle) + txReadOffset, output + numFrames * frameSize, n);
+        numFrames += n;
+        txReadOffset += n * 2;
+
+        if (txReadOffset >= txReadLength)
+        {
+            txRing.releaseRead(txReadHandle);
+            txReading = false;
+        }
+    }
+
+    //ran dry, play silence and count it unless the burst was ended
+    if (numFrames < nBufferFrames)
+    {
+        std::memset(output + numFrames * frameSize, 0, (nBufferFrames - numFrames) * frameSize * sizeof(float));
+        if (txBurst.load()) txUnderflows++;
+    }
+
+    //notify writeStream(), never blocks on the lock
+    _tx_cond.notify_one();
+
+    return 0;
+}
+
+int SoapyAudio::writeStream(
+        SoapySDR::Stream *stream,
+        const void * const *buffs,
+        const size_t numElems,
+        int &flags,
+        const long long timeNs,
+        const long timeoutUs)
+{
+    if (!isTxStream(stream)) return SOAPY_SDR_NOT_SUPPORTED;
+    if (!txActive.load() || !txDevice().isStreamRunning()) return SOAPY_SDR_STREAM_ERROR;
+
+    const size_t underflows = txUnderflows.load();
+    if (underflows != txUnderflowsLogged)
+    {
+        txUnderflowsLogged = underflows;
+        SoapySDR::log(SOAPY_SDR_SSI, "U");
+    }
+
+    //partially filled slots carry over into the next call
+    if (!txWriting)
+    {
+        void *buff;
+        int ret = this->acquireWriteBuffer(stream, txWriteHandle, &buff, timeoutUs);
+        if (ret < 0) return ret;
+        txWriteOffset = 0;
+        txWriting = true;
+    }
+
+    const size_t slotElems = txRing.getSlotSize() / 2;
+    const size_t writtenElems = std::min(slotElems - txWriteOffset, numElems);
+    convertTxInput(buffs[0], txRing.getSlot(txWriteHandle) + txWriteOffset * 2, writtenElems);
+    txWriteOffset += writtenElems;
+
+    //a burst only ends once its last sample is queued
+    const bool endBurst = (flags & SOAPY_SDR_END_BURST) && writtenElems == numElems;
+    if (txWriteOffset == slotElems || endBurst)
+    {
+        int releaseFlags = endBurst ? SOAPY_SDR_END_BURST : 0;
+        this->releaseWriteBuffer(stream, txWriteHandle, txWriteOffset, releaseFlags, timeNs);
+        txWriting = false;
+    }
+
+    return writtenElems;
+}
+
+int SoapyAudio::readStreamStatus(
+        SoapySDR::Stream *stream,
+        size_t &chanMask,
+        int &flags,
+        long long &timeNs,
+        const long timeoutUs)
+{
+    if (!isTxStream(stream)) return SOAPY_SDR_NOT_SUPPORTED;
+
+    const auto exitTime = std::chrono::steady_clock::now() + std::chrono::microseconds(timeoutUs);
+    while (true)
+    {
+        const size_t underflows = txUnderflows.load();
+        if (underflows != txUnderflowsReported)
+        {
+            txUnderflowsReported = underflows;
+            chanMask = 1;
+            flags = 0;
+            return SOAPY_SDR_UNDERFLOW;
+        }
+
+        if (std::chrono::steady_clock::now() >= exitTime) return SOAPY_SDR_TIMEOUT;
+
+        std::unique_lock<std::mutex> lock(_tx_mutex);
+        _tx_cond.wait_until(lock, exitTime);
+    }
+}
+
+int SoapyAudio::acquireWriteBuffer(
+    SoapySDR::Stream *stream,
+    size_t &handle,
+    void **buffs,
+    const long timeoutUs)
+{
+    const auto exitTime = std::chrono::steady_clock::now() + std::chrono::microseconds(timeoutUs);
+
+    //the callback notifies without the lock, so waits are kept short
+    //and a missed wakeup only costs one poll interval
+    while (!txRing.acquireWrite(handle))
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= exitTime) return SOAPY_SDR_TIMEOUT;
+
+        std::unique_lock<std::mutex> lock(_tx_mutex);
+        _tx_cond.wait_until(lock, std::min(exitTime, now + std::chrono::milliseconds(1)));
+    }
+
+    buffs[0] = (void *) txRing.getSlot(handle);
+    return txRing.getSlotSize() / 2;
+}
+
+void SoapyAudio::releaseWriteBuffer(
+    SoapySDR::Stream *stream,
+    const size_t handle,
+    const size_t numElems,
+    int &flags,
+    const long long timeNs)
+{
+    txRing.releaseWrite(handle, numElems * 2);
+    txBurst.store((flags & SOAPY_SDR_END_BURST) == 0);
 }